@@ -0,0 +1,125 @@
+#include "bit_packing.h"
+#include <algorithm>
+#ifdef SEARCH_SERVER_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+const size_t LANE_COUNT = 4;
+const size_t VALUES_PER_LANE = BIT_PACKED_BLOCK_SIZE / LANE_COUNT;
+
+uint32_t RequiredBitWidth(uint32_t max_value) {
+    uint32_t bit_width = 0;
+    while (bit_width < 32 && (max_value >> bit_width) != 0) {
+        ++bit_width;
+    }
+    return bit_width;
+}
+
+size_t PackedBlockWordCount(uint32_t bit_width) {
+    return LANE_COUNT * bit_width;
+}
+
+void PackBlock(const uint32_t* values, uint32_t bit_width, vector<uint32_t>& words) {
+        const size_t first_word = words.size();
+        words.resize(first_word + PackedBlockWordCount(bit_width));
+        PackBlock(values, bit_width, words.data() + first_word);
+    }
+
+void PackBlock(const uint32_t* values, uint32_t bit_width, uint32_t* packed) {
+        if (bit_width == 0) {
+            return;
+        }
+        fill(packed, packed + PackedBlockWordCount(bit_width), 0);
+        for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+            for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+                const uint32_t value = values[i * LANE_COUNT + lane];
+                const size_t bit = i * bit_width;
+                const size_t word = bit / 32;
+                const uint32_t shift = bit % 32;
+                packed[word * LANE_COUNT + lane] |= value << shift;
+                if (shift + bit_width > 32) {
+                    packed[(word + 1) * LANE_COUNT + lane] |= value >> (32 - shift);
+                }
+            }
+        }
+    }
+
+#ifdef SEARCH_SERVER_HAS_SSE2
+void UnpackBlock(const uint32_t* words, uint32_t bit_width, uint32_t* values) {
+        __m128i* out = reinterpret_cast<__m128i*>(values);
+        if (bit_width == 0) {
+            for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+                _mm_storeu_si128(out + i, _mm_setzero_si128());
+            }
+            return;
+        }
+        const __m128i* in = reinterpret_cast<const __m128i*>(words);
+        const __m128i mask = _mm_set1_epi32(bit_width == 32 ? -1 : static_cast<int>((1u << bit_width) - 1));
+        __m128i word = _mm_loadu_si128(in++);
+        uint32_t shift = 0;
+        for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+            __m128i value = _mm_srl_epi32(word, _mm_cvtsi32_si128(shift));
+            shift += bit_width;
+            if (shift >= 32 && i + 1 < VALUES_PER_LANE) {
+                word = _mm_loadu_si128(in++);
+                shift -= 32;
+                if (shift > 0) {
+                    value = _mm_or_si128(value, _mm_sll_epi32(word, _mm_cvtsi32_si128(bit_width - shift)));
+                }
+            }
+            _mm_storeu_si128(out + i, _mm_and_si128(value, mask));
+        }
+    }
+
+void DecodeGaps(const uint32_t* gaps, int first_id, int* ids) {
+        // Prefix sums of gap + 1 four at a time, the carry holds the last id of the previous group
+        const __m128i* in = reinterpret_cast<const __m128i*>(gaps);
+        __m128i* out = reinterpret_cast<__m128i*>(ids);
+        const __m128i one = _mm_set1_epi32(1);
+        __m128i carry = _mm_set1_epi32(first_id - 1);
+        for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+            __m128i value = _mm_add_epi32(_mm_loadu_si128(in + i), one);
+            value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+            value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+            value = _mm_add_epi32(value, carry);
+            _mm_storeu_si128(out + i, value);
+            carry = _mm_shuffle_epi32(value, 0xFF);
+        }
+    }
+#else
+void UnpackBlock(const uint32_t* words, uint32_t bit_width, uint32_t* values) {
+        const uint32_t mask = bit_width == 32 ? ~0u : (1u << bit_width) - 1;
+        for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+            for (size_t i = 0; i < VALUES_PER_LANE; ++i) {
+                if (bit_width == 0) {
+                    values[i * LANE_COUNT + lane] = 0;
+                    continue;
+                }
+                const size_t bit = i * bit_width;
+                const size_t word = bit / 32;
+                const uint32_t shift = bit % 32;
+                uint32_t value = words[word * LANE_COUNT + lane] >> shift;
+                if (shift + bit_width > 32) {
+                    value |= words[(word + 1) * LANE_COUNT + lane] << (32 - shift);
+                }
+                values[i * LANE_COUNT + lane] = value & mask;
+            }
+        }
+    }
+
+void DecodeGaps(const uint32_t* gaps, int first_id, int* ids) {
+        uint32_t id = static_cast<uint32_t>(first_id) - 1;
+        for (size_t i = 0; i < BIT_PACKED_BLOCK_SIZE; ++i) {
+            id += gaps[i] + 1;
+            ids[i] = static_cast<int>(id);
+        }
+    }
+#endif
+
+void EncodeGaps(const int* ids, size_t size, uint32_t* gaps) {
+        for (size_t i = 0; i < BIT_PACKED_BLOCK_SIZE; ++i) {
+            gaps[i] = (i == 0 || i >= size) ? 0 : static_cast<uint32_t>(ids[i] - ids[i - 1] - 1);
+        }
+    }
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "simd.h"
+
+// Blocks of BIT_PACKED_BLOCK_SIZE unsigned values packed with a common bit width.
+// Values are interleaved across four 32-bit lanes (value i goes to lane i % 4), so a block
+// of width b takes 4 * b words and SSE2 unpacks four values per instruction.
+// Without SSE2, or with SEARCH_SERVER_NO_SIMD defined, the same layout is decoded by scalar code
+const size_t BIT_PACKED_BLOCK_SIZE = 128;
+
+// Bits needed to store values up to max_value, 0 for 0
+uint32_t RequiredBitWidth(uint32_t max_value);
+
+size_t PackedBlockWordCount(uint32_t bit_width);
+
+// Appends the packed block to words
+void PackBlock(const uint32_t* values, uint32_t bit_width, std::vector<uint32_t>& words);
+
+// Overwrites the PackedBlockWordCount(bit_width) words starting at words
+void PackBlock(const uint32_t* values, uint32_t bit_width, uint32_t* words);
+
+void UnpackBlock(const uint32_t* words, uint32_t bit_width, uint32_t* values);
+
+// Gaps of ascending ids: gaps[0] = 0, gaps[i] = ids[i] - ids[i - 1] - 1.
+// Unused tail of a partial block is zero
+void EncodeGaps(const int* ids, size_t size, uint32_t* gaps);
+
+// Restores a whole block of ids from its gaps and first id
+void DecodeGaps(const uint32_t* gaps, int first_id, int* ids);
@@ -0,0 +1,62 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <cstddef>
+
+// Blocking FIFO of at most capacity items between pipeline stages: a full queue blocks
+// the producer, which gives backpressure and bounds the memory held between stages
+template <typename Item>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    // Returns false and drops the item if the queue is closed
+    bool Push(Item item) {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [this]() {
+            return closed_ || items_.size() < capacity_;
+        });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Blocks until an item is available, returns nothing once the queue is closed and drained
+    std::optional<Item> Pop() {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this]() {
+            return closed_ || !items_.empty();
+        });
+        if (items_.empty()) {
+            return std::nullopt;
+        }
+        Item item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return item;
+    }
+
+    // Wakes up everybody, items already queued can still be popped
+    void Close() {
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<Item> items_;
+    bool closed_ = false;
+};
@@ -0,0 +1,50 @@
+#include "corpus_statistics.h"
+
+using namespace std;
+
+CorpusStatistics::CorpusStatistics(shared_ptr<const CorpusStatistics> base)
+    : base_(move(base))
+{
+}
+
+void CorpusStatistics::AddDocument(const vector<string_view>& words) {
+    for (const string_view word : words) {
+        const uint32_t term_id = terms_.Intern(word);
+        if (term_id >= document_freqs_.size()) {
+            document_freqs_.resize(term_id + 1, 0);
+        }
+        ++document_freqs_[term_id];
+    }
+    ++document_count_;
+    ++generation_;
+}
+
+void CorpusStatistics::RemoveDocument(const vector<string_view>& words) {
+    for (const string_view word : words) {
+        // Words of a base document may be new to this object
+        const uint32_t term_id = base_ ? terms_.Intern(word) : terms_.Find(word);
+        if (term_id == TermDictionary::NO_TERM) {
+            continue;
+        }
+        if (term_id >= document_freqs_.size()) {
+            document_freqs_.resize(term_id + 1, 0);
+        }
+        --document_freqs_[term_id];
+    }
+    --document_count_;
+    ++generation_;
+}
+
+int CorpusStatistics::GetDocumentFreq(const string_view word) const {
+    const uint32_t term_id = terms_.Find(word);
+    const int base_freq = base_ ? base_->GetDocumentFreq(word) : 0;
+    return term_id == TermDictionary::NO_TERM ? base_freq : base_freq + document_freqs_[term_id];
+}
+
+string_view CorpusStatistics::FindWord(const string_view word) const {
+    const uint32_t term_id = terms_.Find(word);
+    if (term_id == TermDictionary::NO_TERM) {
+        return base_ ? base_->FindWord(word) : string_view();
+    }
+    return terms_.GetTerm(term_id);
+}
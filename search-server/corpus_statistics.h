@@ -0,0 +1,47 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "term_dictionary.h"
+
+// Document frequencies of a corpus that is split across several SearchServer instances.
+// Every part computes IDF from these corpus-wide numbers, so relevances don't depend
+// on how documents are distributed
+class CorpusStatistics {
+public:
+    CorpusStatistics() = default;
+
+    // Statistics of base plus the documents added to and removed from this object. The base is
+    // shared, not copied, so a few changes over a large corpus stay cheap to copy
+    explicit CorpusStatistics(std::shared_ptr<const CorpusStatistics> base);
+
+    // words must be the distinct words of one document
+    void AddDocument(const std::vector<std::string_view>& words);
+
+    void RemoveDocument(const std::vector<std::string_view>& words);
+
+    int GetDocumentCount() const {
+        return document_count_ + (base_ ? base_->GetDocumentCount() : 0);
+    }
+
+    // Grows on every change of the statistics
+    uint64_t GetGeneration() const {
+        return generation_ + (base_ ? base_->GetGeneration() : 0);
+    }
+
+    // Number of documents containing the word, 0 for unknown words
+    int GetDocumentFreq(const std::string_view word) const;
+
+    // The stored copy of a word that was ever added, empty view for unknown words.
+    // Stored words live as long as the statistics
+    std::string_view FindWord(const std::string_view word) const;
+
+private:
+    std::shared_ptr<const CorpusStatistics> base_;
+    // Frequencies relative to the base, negative for words of removed base documents
+    TermDictionary terms_;
+    std::vector<int> document_freqs_;
+    int document_count_ = 0;
+    uint64_t generation_ = 0;
+};
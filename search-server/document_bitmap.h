@@ -0,0 +1,120 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include "simd.h"
+
+// Set of document ordinals as a plain bitmap, a 64-bit word per 64 ordinals.
+// Used as the candidate mask of EvaluateMaxScore: a rejected candidate skips the cursors
+// over the whole run of unset bits found word by word
+class DocumentBitmap {
+public:
+    bool Contains(int document_id) const {
+        const size_t word = static_cast<size_t>(document_id) / 64;
+        return word < words_.size() && (words_[word] >> (document_id % 64) & 1) != 0;
+    }
+
+    // The smallest document >= document_id in the set, INT_MAX if there is none
+    int NextDocument(int document_id) const {
+        size_t word = static_cast<size_t>(document_id) / 64;
+        if (word >= words_.size()) {
+            return INT_MAX;
+        }
+        uint64_t bits = words_[word] & (~uint64_t(0) << (document_id % 64));
+        while (bits == 0) {
+            if (++word == words_.size()) {
+                return INT_MAX;
+            }
+            bits = words_[word];
+        }
+        return static_cast<int>(word * 64 + CountTrailingZeros(bits));
+    }
+
+    // The smallest document >= document_id not in the set
+    int NextMissing(int document_id) const {
+        size_t word = static_cast<size_t>(document_id) / 64;
+        if (word >= words_.size()) {
+            return document_id;
+        }
+        uint64_t bits = ~words_[word] & (~uint64_t(0) << (document_id % 64));
+        while (bits == 0) {
+            if (++word == words_.size()) {
+                return static_cast<int>(word * 64);
+            }
+            bits = ~words_[word];
+        }
+        return static_cast<int>(word * 64 + CountTrailingZeros(bits));
+    }
+
+    void Insert(int document_id) {
+        const size_t word = static_cast<size_t>(document_id) / 64;
+        if (word >= words_.size()) {
+            words_.resize(word + 1, 0);
+        }
+        words_[word] |= uint64_t(1) << (document_id % 64);
+    }
+
+    void Erase(int document_id) {
+        const size_t word = static_cast<size_t>(document_id) / 64;
+        if (word < words_.size()) {
+            words_[word] &= ~(uint64_t(1) << (document_id % 64));
+        }
+    }
+
+    void Clear() {
+        words_.clear();
+    }
+
+    size_t GetMemoryUsage() const {
+        return words_.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    std::vector<uint64_t> words_;
+};
+
+// Candidate mask that admits every document
+struct AllDocuments {
+    bool Contains(int document_id) const {
+        return true;
+    }
+
+    int NextDocument(int document_id) const {
+        return document_id;
+    }
+};
+
+// Documents of mask that are in none of the excluded bitmaps, runs of excluded documents
+// are skipped word by word
+template <typename DocumentMask>
+struct ExcludingMask {
+    const DocumentMask& mask;
+    const std::vector<const DocumentBitmap*>& excluded;
+
+    bool Contains(int document_id) const {
+        return mask.Contains(document_id) && std::none_of(excluded.begin(), excluded.end(), [document_id](const DocumentBitmap* bitmap) {
+            return bitmap->Contains(document_id);
+        });
+    }
+
+    int NextDocument(int document_id) const {
+        bool is_moved = true;
+        while (is_moved) {
+            document_id = mask.NextDocument(document_id);
+            if (document_id == INT_MAX) {
+                return document_id;
+            }
+            is_moved = false;
+            for (const DocumentBitmap* bitmap : excluded) {
+                const int next_document_id = bitmap->NextMissing(document_id);
+                if (next_document_id != document_id) {
+                    document_id = next_document_id;
+                    is_moved = true;
+                }
+            }
+        }
+        return document_id;
+    }
+};
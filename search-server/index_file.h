@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+
+// Binary index written by SearchServer::SaveIndex and served by MappedSearchServer.
+// Numbers are stored in the native byte order, every section starts at an 8-byte aligned
+// offset from the start of the file, so the mapped file is used in place.
+// The version is bumped on every incompatible layout change
+
+const uint64_t INDEX_FILE_MAGIC = 0x58444E4953525653;  // "SVRSINDX"
+const uint32_t INDEX_FILE_VERSION = 1;
+
+struct IndexFileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t file_size;
+
+    uint64_t document_count;
+    uint64_t term_count;
+    uint64_t stop_word_count;
+    uint64_t posting_count;
+    uint64_t strings_size;
+
+    // Documents as parallel arrays ordered by id: int32_t ids, ratings and statuses
+    uint64_t document_ids_offset;
+    uint64_t document_ratings_offset;
+    uint64_t document_statuses_offset;
+    // IndexFileTerm[term_count] ordered by term
+    uint64_t terms_offset;
+    // IndexFileString[stop_word_count] ordered by word
+    uint64_t stop_words_offset;
+    // Postings of all terms back to back: int32_t ids ascending within a term, double term frequencies
+    uint64_t posting_ids_offset;
+    uint64_t posting_freqs_offset;
+    // Characters of terms and stop words, not null-terminated
+    uint64_t strings_offset;
+};
+
+struct IndexFileString {
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct IndexFileTerm {
+    IndexFileString term;
+    uint64_t postings_offset;
+    uint64_t posting_count;
+    double max_term_freq;
+    // IDF at the moment of saving, so corpus-wide statistics of a sharded index are kept
+    double inverse_document_freq;
+};
+
+inline uint64_t AlignIndexFileOffset(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
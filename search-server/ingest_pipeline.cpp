@@ -0,0 +1,184 @@
+#include "ingest_pipeline.h"
+#include "bounded_queue.h"
+#include "string_processing.h"
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <charconv>
+#include <execution>
+
+using namespace std;
+
+using namespace std::string_literals;
+
+// Batches travel by pointer: documents and tokens are views into text, which must not move
+struct IngestBatch {
+    string text;
+    vector<SearchServer::NewDocument> documents;
+    vector<SearchServer::TokenizedDocument> tokenized_documents;
+};
+
+int ParseDocumentNumber(const string_view field, const string& what) {
+    int value = 0;
+    const auto [end, error] = from_chars(field.data(), field.data() + field.size(), value);
+    if (field.empty() || error != errc() || end != field.data() + field.size()) {
+        throw invalid_argument("Invalid "s + what + " "s + string(field));
+    }
+    return value;
+}
+
+DocumentStatus ParseDocumentStatus(const string_view field) {
+    if (field == "ACTUAL"sv) {
+        return DocumentStatus::ACTUAL;
+    } else if (field == "IRRELEVANT"sv) {
+        return DocumentStatus::IRRELEVANT;
+    } else if (field == "BANNED"sv) {
+        return DocumentStatus::BANNED;
+    } else if (field == "REMOVED"sv) {
+        return DocumentStatus::REMOVED;
+    }
+    throw invalid_argument("Invalid document status "s + string(field));
+}
+
+SearchServer::NewDocument ParseDocumentLine(string_view line) {
+        string_view fields[3];
+        for (string_view& field : fields) {
+            const size_t tab = line.find('\t');
+            if (tab == line.npos) {
+                throw invalid_argument("Document line must have 4 tab-separated fields"s);
+            }
+            field = line.substr(0, tab);
+            line.remove_prefix(tab + 1);
+        }
+        SearchServer::NewDocument document{ParseDocumentNumber(fields[0], "document id"s), line, ParseDocumentStatus(fields[1]), {}};
+        for (const string_view rating : SplitIntoWords(fields[2])) {
+            if (!rating.empty()) {
+                document.ratings.push_back(ParseDocumentNumber(rating, "rating"s));
+            }
+        }
+        return document;
+    }
+
+void ReadBatches(istream& input, size_t batch_bytes, BoundedQueue<unique_ptr<IngestBatch>>& batches) {
+        // A line cut by the end of a read is carried over to the next batch
+        string carry;
+        bool is_end = false;
+        while (!is_end) {
+            auto batch = make_unique<IngestBatch>();
+            batch->text = move(carry);
+            carry.clear();
+            size_t line_end = batch->text.npos;
+            while (line_end == batch->text.npos && !is_end) {
+                const size_t old_size = batch->text.size();
+                batch->text.resize(old_size + batch_bytes);
+                input.read(batch->text.data() + old_size, static_cast<streamsize>(batch_bytes));
+                batch->text.resize(old_size + static_cast<size_t>(input.gcount()));
+                if (input.bad()) {
+                    throw runtime_error("Can't read documents"s);
+                }
+                is_end = !input;
+                line_end = batch->text.rfind('\n');
+            }
+            if (!is_end) {
+                carry.assign(batch->text, line_end + 1);
+                batch->text.resize(line_end + 1);
+            }
+            if (batch->text.empty()) {
+                continue;
+            }
+            if (!batches.Push(move(batch))) {
+                return;
+            }
+        }
+    }
+
+void ParseBatch(const SearchServer& server, IngestBatch& batch, size_t& line_number) {
+        string_view text = batch.text;
+        while (!text.empty()) {
+            ++line_number;
+            const size_t line_end = min(text.find('\n'), text.size());
+            string_view line = text.substr(0, line_end);
+            text.remove_prefix(min(line_end + 1, text.size()));
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.empty()) {
+                continue;
+            }
+            try {
+                batch.documents.push_back(ParseDocumentLine(line));
+            } catch (const invalid_argument& error) {
+                throw invalid_argument("Line "s + to_string(line_number) + ": "s + error.what());
+            }
+        }
+        batch.tokenized_documents = server.TokenizeDocuments(execution::par, batch.documents);
+    }
+
+size_t IngestDocuments(SearchServer& server, istream& input, const IngestOptions& options) {
+        BoundedQueue<unique_ptr<IngestBatch>> read_batches(options.queue_capacity);
+        BoundedQueue<unique_ptr<IngestBatch>> parsed_batches(options.queue_capacity);
+        mutex error_mutex;
+        exception_ptr first_error;
+        // Stops every stage, the first error wins
+        const auto fail = [&](exception_ptr error) {
+            {
+                lock_guard guard(error_mutex);
+                if (!first_error) {
+                    first_error = error;
+                }
+            }
+            read_batches.Close();
+            parsed_batches.Close();
+        };
+
+        thread reader([&]() {
+            try {
+                ReadBatches(input, max<size_t>(options.batch_bytes, 1), read_batches);
+            } catch (...) {
+                fail(current_exception());
+            }
+            read_batches.Close();
+        });
+        // Tokenizing only reads the stop words, so it overlaps with indexing of the previous batch
+        thread parser([&]() {
+            try {
+                size_t line_number = 0;
+                while (auto batch = read_batches.Pop()) {
+                    ParseBatch(server, **batch, line_number);
+                    if (!parsed_batches.Push(move(*batch))) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                fail(current_exception());
+            }
+            parsed_batches.Close();
+        });
+
+        size_t document_count = 0;
+        try {
+            while (auto batch = parsed_batches.Pop()) {
+                server.AddTokenizedDocuments(execution::par, (*batch)->tokenized_documents);
+                document_count += (*batch)->documents.size();
+            }
+        } catch (...) {
+            fail(current_exception());
+        }
+        reader.join();
+        parser.join();
+        if (first_error) {
+            rethrow_exception(first_error);
+        }
+        return document_count;
+    }
+
+size_t IngestDocuments(SearchServer& server, const string& path, const IngestOptions& options) {
+        ifstream input(path, ios::binary);
+        if (!input) {
+            throw runtime_error("Can't open "s + path);
+        }
+        return IngestDocuments(server, input, options);
+    }
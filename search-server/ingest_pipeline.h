@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <istream>
+#include <cstddef>
+#include "search_server.h"
+
+// Bulk loading of document dumps with one document per line:
+//     id <TAB> status <TAB> space-separated ratings <TAB> text
+// status is ACTUAL, IRRELEVANT, BANNED or REMOVED, ratings may be empty.
+// Empty lines and a '\r' before the line end are ignored
+struct IngestOptions {
+    // Bytes read at once, every read makes a batch of the whole lines in it
+    size_t batch_bytes = 4 << 20;
+    // Batches waiting between two stages; with batch_bytes bounds the memory in flight
+    size_t queue_capacity = 2;
+};
+
+// Throws std::invalid_argument for malformed lines, the text points into the line
+SearchServer::NewDocument ParseDocumentLine(std::string_view line);
+
+// Reading, parsing with tokenizing, and indexing run as concurrent stages over batches,
+// a stage that gets ahead blocks on a full queue. Returns the number of added documents.
+// Errors stop the ingestion and are rethrown, invalid lines report their line number;
+// documents of the batches indexed before stay in the server
+size_t IngestDocuments(SearchServer& server, std::istream& input, const IngestOptions& options = {});
+
+// Throws std::runtime_error if the file can't be opened
+size_t IngestDocuments(SearchServer& server, const std::string& path, const IngestOptions& options = {});
@@ -1,12 +1,15 @@
 #include "process_queries.h"
 #include "search_server.h"
 #include "test_example_functions.h"
+#include "thread_pool.h"
 #include <execution>
 #include <random>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <cassert>
+#include <thread>
+#include <memory>
 #include "log_duration.h"
 using namespace std;
 string GenerateWord(mt19937& generator, int max_length) {
@@ -48,21 +51,69 @@ vector<string> GenerateQueries(mt19937& generator, const vector<string>& diction
     }
     return queries;
 }
+template <typename ExecutionPolicy>
+void Test(const string& mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+// Removing documents compacts the ordinals; documents that kept theirs must keep their terms too
+void TestCompactionKeepsDocuments() {
+    const auto text = [](int id) {
+        return "dog w"s + to_string(id % 3) + (id % 2 == 0 ? " cat"s : ""s);
+    };
+    SearchServer search_server("and"s);
+    for (int id = 0; id < 10; ++id) {
+        search_server.AddDocument(id, text(id), DocumentStatus::ACTUAL, {id});
+    }
+    for (int id = 4; id < 10; ++id) {
+        search_server.RemoveDocument(id);
+    }
+    search_server.RemoveDocument(0);
+    assert(search_server.GetWordFrequencies(1).size() == 2);
+    search_server.RemoveDocument(1);
+    search_server.RemoveDocument(2);
+    search_server.AddDocument(10, text(10), DocumentStatus::ACTUAL, {10});
+
+    SearchServer expected("and"s);
+    for (const int id : {3, 10}) {
+        expected.AddDocument(id, text(id), DocumentStatus::ACTUAL, {id});
+    }
+    for (const string query : {"cat"s, "dog w0"s, "w1 -cat"s}) {
+        const auto found = search_server.FindTopDocuments(query);
+        const auto reference = expected.FindTopDocuments(query);
+        assert(found.size() == reference.size());
+        for (size_t i = 0; i < found.size(); ++i) {
+            assert(found[i].id == reference[i].id && found[i].relevance == reference[i].relevance);
+        }
+    }
+}
 int main() {
+    TestCompactionKeepsDocuments();
     mt19937 generator;
-    const auto dictionary = GenerateDictionary(generator, 10, 10);
-    const auto documents = GenerateQueries(generator, dictionary, 1000, 10);
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
     SearchServer search_server(dictionary[0]);
     for (size_t i = 0; i < documents.size(); ++i) {
         search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
     }
-    vector<Document> res_seq, res_par;
-    {LOG_DURATION("seq");
-    res_seq = search_server.FindTopDocuments(documents[0]);
-    }
-    {LOG_DURATION("par");
-    res_par = search_server.FindTopDocuments(execution::par, documents[0]);
+    const auto queries = GenerateQueries(generator, dictionary, 100, 70);
+    // A zero result count is valid and must not touch the empty top
+    assert(search_server.FindTopDocuments(execution::seq, queries[0], DocumentStatus::ACTUAL, 0).empty());
+    assert(search_server.FindTopDocuments(execution::par, queries[0], DocumentStatus::ACTUAL, 0).empty());
+    Test("seq"s, search_server, queries, execution::seq);
+    Test("par"s, search_server, queries, execution::par);
+    // Parallel scoring shares no locks, so it should scale with the number of worker threads
+    for (size_t threads = 1; threads <= thread::hardware_concurrency(); threads *= 2) {
+        search_server.SetExecutor(make_shared<ThreadPool>(threads));
+        Test("par, "s + to_string(threads) + " threads"s, search_server, queries, execution::par);
     }
+    search_server.SetExecutor(nullptr);
     cout << "OK!" << endl;
     return 0;
 }
\ No newline at end of file
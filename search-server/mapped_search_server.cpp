@@ -0,0 +1,259 @@
+#include "mapped_search_server.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+using namespace std::string_literals;
+
+MappedSearchServer::MappedSearchServer(const string& path) {
+        Map(path);
+        try {
+            Validate();
+        } catch (...) {
+            Unmap();
+            throw;
+        }
+    }
+
+MappedSearchServer::~MappedSearchServer() {
+        Unmap();
+    }
+
+const int32_t* MappedSearchServer::begin() const {
+    return document_ids_;
+}
+
+const int32_t* MappedSearchServer::end() const {
+    return document_ids_ + header_->document_count;
+}
+
+vector<Document> MappedSearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(execution::seq, raw_query, status, top_k);
+}
+
+vector<Document> MappedSearchServer::FindTopDocuments(const string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+int MappedSearchServer::GetDocumentCount() const {
+        return static_cast<int>(header_->document_count);
+    }
+
+int MappedSearchServer::GetDocumentRating(int document_id) const {
+        const size_t position = FindDocument(document_id);
+        if (position == header_->document_count) {
+            throw out_of_range("Defunct document_id"s);
+        }
+        return document_ratings_[position];
+    }
+
+DocumentStatus MappedSearchServer::GetDocumentStatus(int document_id) const {
+        const size_t position = FindDocument(document_id);
+        if (position == header_->document_count) {
+            throw out_of_range("Defunct document_id"s);
+        }
+        return static_cast<DocumentStatus>(document_statuses_[position]);
+    }
+
+tuple<SearchServer::MatchWords, DocumentStatus> MappedSearchServer::MatchDocument(const string_view raw_query, int document_id) const {
+        const size_t position = FindDocument(document_id);
+        if (position == header_->document_count) {
+            throw out_of_range("Defunct document_id"s);
+        }
+        const auto query = ParseQuery(raw_query);
+        const auto contains = [this, document_id](size_t term) {
+            auto cursor = GetCursor(term);
+            cursor.SkipTo(document_id);
+            return !cursor.IsEnd() && cursor.DocumentId() == document_id;
+        };
+
+        vector<string_view> matched_words;
+        if (none_of(query.minus_terms.begin(), query.minus_terms.end(), contains)) {
+            // The term table is ordered by term, so the words come out sorted
+            for (const size_t term : query.plus_terms) {
+                if (contains(term)) {
+                    matched_words.push_back(GetString(terms_[term].term));
+                }
+            }
+        }
+        return {matched_words, static_cast<DocumentStatus>(document_statuses_[position])};
+    }
+
+#ifdef _WIN32
+void MappedSearchServer::Map(const string& path) {
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw runtime_error("Can't open index file "s + path);
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file);
+            throw runtime_error("Invalid index file "s + path);
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (data == nullptr) {
+            if (mapping) {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            throw runtime_error("Can't map index file "s + path);
+        }
+        file_handle_ = file;
+        mapping_handle_ = mapping;
+        data_ = static_cast<const char*>(data);
+        size_ = static_cast<size_t>(file_size.QuadPart);
+    }
+
+void MappedSearchServer::Unmap() {
+        if (data_ != nullptr) {
+            UnmapViewOfFile(data_);
+            CloseHandle(mapping_handle_);
+            CloseHandle(file_handle_);
+            data_ = nullptr;
+        }
+    }
+#else
+void MappedSearchServer::Map(const string& path) {
+        const int file = open(path.c_str(), O_RDONLY);
+        if (file < 0) {
+            throw runtime_error("Can't open index file "s + path);
+        }
+        struct stat file_stat;
+        if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0) {
+            close(file);
+            throw runtime_error("Invalid index file "s + path);
+        }
+        void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        // The mapping keeps its own reference to the file
+        close(file);
+        if (data == MAP_FAILED) {
+            throw runtime_error("Can't map index file "s + path);
+        }
+        data_ = static_cast<const char*>(data);
+        size_ = static_cast<size_t>(file_stat.st_size);
+    }
+
+void MappedSearchServer::Unmap() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char*>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+#endif
+
+void MappedSearchServer::Validate() {
+        if (size_ < sizeof(IndexFileHeader)) {
+            throw runtime_error("Index file is truncated"s);
+        }
+        header_ = reinterpret_cast<const IndexFileHeader*>(data_);
+        if (header_->magic != INDEX_FILE_MAGIC) {
+            throw runtime_error("Not an index file"s);
+        }
+        if (header_->version != INDEX_FILE_VERSION) {
+            throw runtime_error("Unsupported index file version "s + to_string(header_->version));
+        }
+        if (header_->file_size != size_) {
+            throw runtime_error("Index file is truncated"s);
+        }
+        if (header_->document_count > static_cast<uint64_t>(INT_MAX)) {
+            throw runtime_error("Index file is corrupted"s);
+        }
+        document_ids_ = GetSection<int32_t>(header_->document_ids_offset, header_->document_count);
+        document_ratings_ = GetSection<int32_t>(header_->document_ratings_offset, header_->document_count);
+        document_statuses_ = GetSection<int32_t>(header_->document_statuses_offset, header_->document_count);
+        terms_ = GetSection<IndexFileTerm>(header_->terms_offset, header_->term_count);
+        stop_words_ = GetSection<IndexFileString>(header_->stop_words_offset, header_->stop_word_count);
+        posting_ids_ = GetSection<int32_t>(header_->posting_ids_offset, header_->posting_count);
+        posting_freqs_ = GetSection<double>(header_->posting_freqs_offset, header_->posting_count);
+        strings_ = GetSection<char>(header_->strings_offset, header_->strings_size);
+    }
+
+template <typename Element>
+    const Element* MappedSearchServer::GetSection(uint64_t offset, uint64_t count) const {
+        if (offset % alignof(Element) != 0 || offset > size_ || count > (size_ - offset) / sizeof(Element)) {
+            throw runtime_error("Index file is corrupted"s);
+        }
+        return reinterpret_cast<const Element*>(data_ + offset);
+    }
+
+string_view MappedSearchServer::GetString(const IndexFileString& string) const {
+        if (string.offset > header_->strings_size || string.length > header_->strings_size - string.offset) {
+            throw runtime_error("Index file is corrupted"s);
+        }
+        return {strings_ + string.offset, static_cast<size_t>(string.length)};
+    }
+
+bool MappedSearchServer::IsStopWord(const string_view word) const {
+        const IndexFileString* last = stop_words_ + header_->stop_word_count;
+        const IndexFileString* it = lower_bound(stop_words_, last, word, [this](const IndexFileString& stop_word, const string_view word) {
+            return GetString(stop_word) < word;
+        });
+        return it != last && GetString(*it) == word;
+    }
+
+size_t MappedSearchServer::FindTerm(const string_view word) const {
+        const IndexFileTerm* last = terms_ + header_->term_count;
+        const IndexFileTerm* it = lower_bound(terms_, last, word, [this](const IndexFileTerm& term, const string_view word) {
+            return GetString(term.term) < word;
+        });
+        if (it != last && GetString(it->term) == word) {
+            return it - terms_;
+        }
+        return header_->term_count;
+    }
+
+MappedSearchServer::PostingsCursor MappedSearchServer::GetCursor(size_t term) const {
+        const IndexFileTerm& entry = terms_[term];
+        if (entry.postings_offset > header_->posting_count || entry.posting_count > header_->posting_count - entry.postings_offset) {
+            throw runtime_error("Index file is corrupted"s);
+        }
+        return PostingsCursor(posting_ids_ + entry.postings_offset, posting_freqs_ + entry.postings_offset, entry.posting_count);
+    }
+
+size_t MappedSearchServer::FindDocument(int document_id) const {
+        const int32_t* it = lower_bound(begin(), end(), document_id);
+        if (it != end() && *it == document_id) {
+            return it - begin();
+        }
+        return header_->document_count;
+    }
+
+MappedSearchServer::Query MappedSearchServer::ParseQuery(const string_view text) const {
+        // Sorted words give the same summation order as SearchServer, so relevances match exactly
+        const auto [plus_words, minus_words] = ParseQueryWords(text, true, [this](const string_view word) {
+            return IsStopWord(word);
+        });
+
+        Query result;
+        for (const string_view word : plus_words) {
+            const size_t term = FindTerm(word);
+            if (term != header_->term_count) {
+                result.plus_terms.push_back(term);
+            }
+        }
+        for (const string_view word : minus_words) {
+            const size_t term = FindTerm(word);
+            if (term != header_->term_count) {
+                result.minus_terms.push_back(term);
+            }
+        }
+        return result;
+    }
+
+void MappedSearchServer::SetExecutor(shared_ptr<ThreadPool> executor) {
+        executor_ = move(executor);
+    }
+
+ThreadPool& MappedSearchServer::GetExecutor() const {
+        return executor_ ? *executor_ : ThreadPool::GetDefault();
+    }
@@ -0,0 +1,234 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <execution>
+#include <type_traits>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include "document.h"
+#include "search_server.h"
+#include "index_file.h"
+#include "max_score.h"
+#include "top_documents.h"
+#include "thread_pool.h"
+#include "string_processing.h"
+
+// Read-only index served straight from a file written by SearchServer::SaveIndex.
+// The file is memory-mapped and used in place, nothing is deserialized: opening it costs
+// a few page faults and a query touches only the pages of its own postings.
+// Results are the same as those of the saved SearchServer.
+// Throws std::runtime_error if the file can't be mapped or is not an index of a supported version
+class MappedSearchServer {
+public:
+    explicit MappedSearchServer(const std::string& path);
+
+    MappedSearchServer(const MappedSearchServer&) = delete;
+
+    MappedSearchServer& operator=(const MappedSearchServer&) = delete;
+
+    ~MappedSearchServer();
+
+    // Document ids in ascending order
+    const int32_t* begin() const;
+
+    const int32_t* end() const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const ;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const ;
+
+    int GetDocumentCount() const ;
+
+    // Both throw std::out_of_range for unknown documents
+    int GetDocumentRating(int document_id) const ;
+
+    DocumentStatus GetDocumentStatus(int document_id) const ;
+
+    // Matched words point into the mapped file and live as long as the server
+    std::tuple<SearchServer::MatchWords, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const ;
+
+    // Pool that runs the work of parallel policies, ThreadPool::GetDefault() unless set
+    void SetExecutor(std::shared_ptr<ThreadPool> executor);
+
+    ThreadPool& GetExecutor() const ;
+
+private:
+    // Cursor over the postings of one term inside the mapped arrays
+    class PostingsCursor {
+    public:
+        PostingsCursor(const int32_t* ids, const double* freqs, size_t size)
+            : ids_(ids)
+            , freqs_(freqs)
+            , size_(size)
+        {
+        }
+
+        bool IsEnd() const {
+            return position_ == size_;
+        }
+
+        int DocumentId() const {
+            return ids_[position_];
+        }
+
+        double TermFreq() const {
+            return freqs_[position_];
+        }
+
+        void Next() {
+            ++position_;
+        }
+
+        void SkipTo(int document_id) {
+            if (position_ != size_ && ids_[position_] < document_id) {
+                position_ = std::lower_bound(ids_ + position_, ids_ + size_, document_id) - ids_;
+            }
+        }
+
+    private:
+        const int32_t* ids_;
+        const double* freqs_;
+        size_t size_;
+        size_t position_ = 0;
+    };
+
+    // Positions in the term table, words missing from it are dropped
+    struct Query {
+        std::vector<size_t> plus_terms;
+        std::vector<size_t> minus_terms;
+    };
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+
+    const IndexFileHeader* header_ = nullptr;
+    const int32_t* document_ids_ = nullptr;
+    const int32_t* document_ratings_ = nullptr;
+    const int32_t* document_statuses_ = nullptr;
+    const IndexFileTerm* terms_ = nullptr;
+    const IndexFileString* stop_words_ = nullptr;
+    const int32_t* posting_ids_ = nullptr;
+    const double* posting_freqs_ = nullptr;
+    const char* strings_ = nullptr;
+
+    std::shared_ptr<ThreadPool> executor_;
+
+    void Map(const std::string& path);
+
+    void Unmap();
+
+    // Checks the header and section bounds only, term entries are checked on use
+    void Validate();
+
+    template <typename Element>
+    const Element* GetSection(uint64_t offset, uint64_t count) const;
+
+    std::string_view GetString(const IndexFileString& string) const;
+
+    bool IsStopWord(const std::string_view word) const ;
+
+    // Position of the term in the term table or term_count
+    size_t FindTerm(const std::string_view word) const ;
+
+    PostingsCursor GetCursor(size_t term) const ;
+
+    // Position of the document in the document arrays or document_count
+    size_t FindDocument(int document_id) const ;
+
+    Query ParseQuery(const std::string_view text) const ;
+
+    // Scores the documents with ids in [first_document_id, last_document_id] that accept_document(position) takes,
+    // position is the one FindDocument gives
+    template <typename DocumentFilter>
+    TopDocumentsCollector FindDocumentsInRange(const Query& query, DocumentFilter accept_document, size_t top_k, int first_document_id, int last_document_id) const ;
+
+    template <typename DocumentFilter, typename ExecutionPolicy>
+    std::vector<Document> FindFilteredDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentFilter accept_document, size_t top_k) const ;
+};
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> MappedSearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindFilteredDocuments(policy, raw_query, [this, &document_predicate](size_t position) {
+            return document_predicate(begin()[position], static_cast<DocumentStatus>(document_statuses_[position]), document_ratings_[position]);
+        }, top_k);
+    }
+
+template <typename DocumentFilter, typename ExecutionPolicy>
+    std::vector<Document> MappedSearchServer::FindFilteredDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentFilter accept_document, size_t top_k) const {
+        const auto query = ParseQuery(raw_query);
+        if constexpr (IsParallelPolicy<ExecutionPolicy>()) {
+            if (header_->document_count == 0) {
+                return {};
+            }
+            return EvaluateInIdChunks(policy, GetExecutor(), *begin(), *(end() - 1), top_k, [&](int first_document_id, int last_document_id) {
+                return FindDocumentsInRange(query, accept_document, top_k, first_document_id, last_document_id);
+            });
+        } else {
+            return FindDocumentsInRange(query, accept_document, top_k, 0, INT_MAX).Extract();
+        }
+    }
+
+template <typename DocumentPredicate>
+    std::vector<Document> MappedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
+    }
+
+template <typename ExecutionPolicy>
+    std::vector<Document> MappedSearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+        // Only the status of a candidate is read, no predicate is called for it
+        return FindFilteredDocuments(policy, raw_query, [this, status](size_t position) {
+            return document_statuses_[position] == static_cast<int32_t>(status);
+        }, top_k);
+    }
+
+template <typename ExecutionPolicy>
+    std::vector<Document> MappedSearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const {
+        return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    }
+
+template <typename DocumentFilter>
+    TopDocumentsCollector MappedSearchServer::FindDocumentsInRange(const Query& query, DocumentFilter accept_document, size_t top_k, int first_document_id, int last_document_id) const {
+        std::vector<ScoredCursor<PostingsCursor>> plus_cursors;
+        for (const size_t term : query.plus_terms) {
+            const IndexFileTerm& entry = terms_[term];
+            plus_cursors.push_back({GetCursor(term), entry.inverse_document_freq, entry.max_term_freq * entry.inverse_document_freq});
+        }
+
+        std::vector<PostingsCursor> minus_cursors;
+        for (const size_t term : query.minus_terms) {
+            minus_cursors.push_back(GetCursor(term));
+        }
+
+        return EvaluateMaxScore(std::move(plus_cursors), std::move(minus_cursors), AllDocuments(), [this, &accept_document](int document_id, Document& document) {
+            const size_t position = FindDocument(document_id);
+            // Postings of a valid file only hold ids of its document table
+            if (position == header_->document_count) {
+                throw std::runtime_error("Index file is corrupted");
+            }
+            document.id = document_id;
+            document.rating = document_ratings_[position];
+            return accept_document(position);
+        }, top_k, first_document_id, last_document_id);
+    }
@@ -0,0 +1,210 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <execution>
+#include <cstddef>
+#include <cstdint>
+#include "document.h"
+#include "top_documents.h"
+#include "document_bitmap.h"
+#include "thread_pool.h"
+
+// Postings cursor of a plus-word with its IDF and the upper bound of its contribution.
+// Cursor needs IsEnd(), DocumentId(), TermFreq(), Next() and SkipTo(document_id)
+template <typename Cursor>
+struct ScoredCursor {
+    Cursor cursor;
+    double inverse_document_freq;
+    double max_score;
+};
+
+// Stop condition of EvaluateMaxScore for queries that always run to the end
+struct NeverStop {
+    bool operator()() const {
+        return false;
+    }
+};
+
+// Scratch buffers of EvaluateMaxScore, reused across queries they don't reallocate
+struct MaxScoreWorkspace {
+    std::vector<size_t> order;
+    std::vector<double> max_score_prefix;
+    std::vector<double> term_scores;
+    std::vector<char> has_term;
+};
+
+// Document-at-a-time MaxScore evaluation over postings with ids in [first_document_id, last_document_id].
+// Terms are ordered by the upper bound of their contribution; the longest prefix of them that
+// together can't lift a document into the current top-k is non-essential: such terms never
+// produce candidates and are only probed while the candidate can still make it.
+// plus_cursors come in query order, contributions are summed in that order so relevances are
+// bit-identical to exhaustive scoring.
+// Candidates outside document_mask (Contains(id) and NextDocument(id), see DocumentBitmap) are
+// dropped before scoring, together with the following ones up to the next document in the mask.
+// document_filter(posting_id, document) is called for surviving candidates, it rejects a document
+// by returning false and otherwise stores the document id and rating, posting ids may be internal.
+// Matches are added to top_documents, the cursors are consumed.
+// should_stop() is polled every STOP_CHECK_INTERVAL candidates; once it returns true the evaluation
+// ends early, top_documents keeps the matches so far and false is returned
+static const unsigned STOP_CHECK_INTERVAL = 256;
+
+template <typename Cursor, typename MinusCursor, typename DocumentMask, typename DocumentFilter, typename StopCondition = NeverStop>
+bool EvaluateMaxScore(std::vector<ScoredCursor<Cursor>>& plus_cursors, std::vector<MinusCursor>& minus_cursors, const DocumentMask& document_mask,
+                      DocumentFilter document_filter, int first_document_id, int last_document_id, MaxScoreWorkspace& workspace, TopDocumentsCollector& top_documents,
+                      StopCondition should_stop = StopCondition()) {
+    const size_t term_count = plus_cursors.size();
+    auto& order = workspace.order;
+    order.resize(term_count);
+    for (size_t i = 0; i < term_count; ++i) {
+        order[i] = i;
+        plus_cursors[i].cursor.SkipTo(first_document_id);
+    }
+    // Ties are broken by position, std::stable_sort would allocate
+    std::sort(order.begin(), order.end(), [&plus_cursors](size_t lhs, size_t rhs) {
+        if (plus_cursors[lhs].max_score != plus_cursors[rhs].max_score) {
+            return plus_cursors[lhs].max_score < plus_cursors[rhs].max_score;
+        }
+        return lhs < rhs;
+    });
+
+    auto& max_score_prefix = workspace.max_score_prefix;
+    max_score_prefix.assign(term_count + 1, 0.0);
+    for (size_t i = 0; i < term_count; ++i) {
+        max_score_prefix[i + 1] = max_score_prefix[i] + plus_cursors[order[i]].max_score;
+    }
+
+    // Contributions of the current document by query position
+    auto& term_scores = workspace.term_scores;
+    auto& has_term = workspace.has_term;
+    term_scores.assign(term_count, 0.0);
+    has_term.assign(term_count, 0);
+    size_t first_essential = 0;
+    unsigned until_stop_check = STOP_CHECK_INTERVAL;
+    while (true) {
+        if (--until_stop_check == 0) {
+            until_stop_check = STOP_CHECK_INTERVAL;
+            if (should_stop()) {
+                return false;
+            }
+        }
+        int document_id = -1;
+        for (size_t i = first_essential; i < term_count; ++i) {
+            const auto& cursor = plus_cursors[order[i]].cursor;
+            if (!cursor.IsEnd() && (document_id < 0 || cursor.DocumentId() < document_id)) {
+                document_id = cursor.DocumentId();
+            }
+        }
+        if (document_id < 0 || document_id > last_document_id) {
+            break;
+        }
+        if (!document_mask.Contains(document_id)) {
+            // Usually the next posting is already in the mask, stepping is cheaper than skipping
+            const int next_document_id = document_mask.NextDocument(document_id);
+            for (size_t i = first_essential; i < term_count; ++i) {
+                auto& cursor = plus_cursors[order[i]].cursor;
+                if (!cursor.IsEnd() && cursor.DocumentId() == document_id) {
+                    cursor.Next();
+                }
+                if (!cursor.IsEnd() && cursor.DocumentId() < next_document_id) {
+                    cursor.SkipTo(next_document_id);
+                }
+            }
+            continue;
+        }
+
+        std::fill(has_term.begin(), has_term.end(), 0);
+        double max_relevance = max_score_prefix[first_essential];
+        for (size_t i = first_essential; i < term_count; ++i) {
+            auto& term = plus_cursors[order[i]];
+            if (!term.cursor.IsEnd() && term.cursor.DocumentId() == document_id) {
+                const double score = term.cursor.TermFreq() * term.inverse_document_freq;
+                term_scores[order[i]] = score;
+                has_term[order[i]] = 1;
+                max_relevance += score;
+                term.cursor.Next();
+            }
+        }
+
+        bool can_enter = top_documents.CanAdmit(max_relevance);
+        for (size_t i = first_essential; can_enter && i-- > 0; ) {
+            auto& term = plus_cursors[order[i]];
+            term.cursor.SkipTo(document_id);
+            max_relevance -= term.max_score;
+            if (!term.cursor.IsEnd() && term.cursor.DocumentId() == document_id) {
+                const double score = term.cursor.TermFreq() * term.inverse_document_freq;
+                term_scores[order[i]] = score;
+                has_term[order[i]] = 1;
+                max_relevance += score;
+            }
+            can_enter = top_documents.CanAdmit(max_relevance);
+        }
+        if (!can_enter) {
+            continue;
+        }
+
+        const bool has_minus_word = std::any_of(minus_cursors.begin(), minus_cursors.end(), [document_id](auto& cursor) {
+            cursor.SkipTo(document_id);
+            return !cursor.IsEnd() && cursor.DocumentId() == document_id;
+        });
+        if (has_minus_word) {
+            continue;
+        }
+
+        Document document;
+        if (!document_filter(document_id, document)) {
+            continue;
+        }
+
+        double relevance = 0.0;
+        for (size_t position = 0; position < term_count; ++position) {
+            if (has_term[position]) {
+                relevance += term_scores[position];
+            }
+        }
+        document.relevance = relevance;
+        top_documents.Add(document);
+
+        while (first_essential < term_count && !top_documents.CanAdmit(max_score_prefix[first_essential + 1])) {
+            ++first_essential;
+        }
+    }
+    return true;
+}
+
+template <typename Cursor, typename MinusCursor, typename DocumentMask, typename DocumentFilter>
+TopDocumentsCollector EvaluateMaxScore(std::vector<ScoredCursor<Cursor>> plus_cursors, std::vector<MinusCursor> minus_cursors, const DocumentMask& document_mask,
+                                       DocumentFilter document_filter, size_t top_k, int first_document_id, int last_document_id) {
+    MaxScoreWorkspace workspace;
+    TopDocumentsCollector top_documents(top_k);
+    EvaluateMaxScore(plus_cursors, minus_cursors, document_mask, document_filter, first_document_id, last_document_id, workspace, top_documents);
+    return top_documents;
+}
+
+// Splits [first_document_id, last_document_id] into disjoint chunks, every worker scores its own
+// chunk into a private top-k with evaluate_range(first, last), so the hot path shares no state;
+// survivors are merged at the end. Chunks run on the pool
+template <typename ExecutionPolicy, typename RangeEvaluator>
+std::vector<Document> EvaluateInIdChunks(ExecutionPolicy policy, ThreadPool& pool, int first_document_id, int last_document_id, size_t top_k,
+                                         RangeEvaluator evaluate_range) {
+    static const size_t CHUNKS_PER_THREAD = 4;
+    const size_t chunk_count = CHUNKS_PER_THREAD * pool.GetThreadCount();
+    const int64_t first_id = first_document_id;
+    const int64_t last_id = last_document_id;
+    const int64_t chunk_width = (last_id - first_id) / static_cast<int64_t>(chunk_count) + 1;
+
+    std::vector<TopDocumentsCollector> chunk_tops(chunk_count, TopDocumentsCollector(top_k));
+    ForEachIndex(policy, pool, chunk_count, [&](size_t chunk){
+        const int64_t chunk_first = first_id + chunk_width * static_cast<int64_t>(chunk);
+        if (chunk_first > last_id) {
+            return;
+        }
+        const int64_t chunk_last = std::min(chunk_first + chunk_width - 1, last_id);
+        chunk_tops[chunk] = evaluate_range(static_cast<int>(chunk_first), static_cast<int>(chunk_last));
+    });
+
+    TopDocumentsCollector top_documents(top_k);
+    for (const auto& chunk_top : chunk_tops) {
+        top_documents.Merge(chunk_top);
+    }
+    return top_documents.Extract();
+}
@@ -4,6 +4,8 @@
 #include<vector>
 #include<iterator>
 #include<ostream>
+#include<string>
+#include<cstddef>
 
 template <typename Iterator>
 class Diaposon {
@@ -79,4 +81,90 @@ class Paginator {
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
+}
+
+// Pages of a query fetched one at a time while iterating, each continuing from the cursor of the
+// previous one. Only the current page is held, a deep page never materializes the results before it
+class QueryPaginator {
+    public:
+        class Iterator {
+            public:
+                using iterator_category = std::input_iterator_tag;
+                using value_type = std::vector<Document>;
+                using difference_type = std::ptrdiff_t;
+                using pointer = const value_type*;
+                using reference = const value_type&;
+
+                Iterator() = default;
+
+                explicit Iterator(const QueryPaginator* paginator)
+                    : paginator_(paginator)
+                {
+                    Fetch(SearchServer::PageCursor());
+                }
+
+                const std::vector<Document>& operator*() const {
+                    return page_.documents;
+                }
+
+                const std::vector<Document>* operator->() const {
+                    return &page_.documents;
+                }
+
+                Iterator& operator++() {
+                    if (page_.has_more) {
+                        Fetch(page_.next);
+                    } else {
+                        paginator_ = nullptr;
+                    }
+                    return *this;
+                }
+
+                // Iterators are equal only when both are past the last page
+                bool operator==(const Iterator& other) const {
+                    return paginator_ == nullptr && other.paginator_ == nullptr;
+                }
+
+                bool operator!=(const Iterator& other) const {
+                    return !(*this == other);
+                }
+
+            private:
+                const QueryPaginator* paginator_ = nullptr;
+                SearchServer::ResultPage page_;
+
+                void Fetch(const SearchServer::PageCursor& cursor) {
+                    page_ = paginator_->search_server_.FindTopDocumentsPage(paginator_->raw_query_, paginator_->status_, paginator_->page_size_, cursor);
+                    if (page_.documents.empty()) {
+                        paginator_ = nullptr;
+                    }
+                }
+        };
+
+        QueryPaginator(const SearchServer& search_server, std::string raw_query, size_t page_size, DocumentStatus status = DocumentStatus::ACTUAL)
+            : search_server_(search_server)
+            , raw_query_(std::move(raw_query))
+            , page_size_(page_size)
+            , status_(status)
+        {
+        }
+
+        // Every begin() runs the query again from the first page
+        Iterator begin() const {
+            return Iterator(this);
+        }
+
+        Iterator end() const {
+            return Iterator();
+        }
+
+    private:
+        const SearchServer& search_server_;
+        std::string raw_query_;
+        size_t page_size_;
+        DocumentStatus status_;
+};
+
+inline QueryPaginator PaginateQuery(const SearchServer& search_server, std::string raw_query, size_t page_size, DocumentStatus status = DocumentStatus::ACTUAL) {
+    return QueryPaginator(search_server, std::move(raw_query), page_size, status);
 }
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include "posting_list.h"
+#include <cmath>
+
+using namespace std;
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+        : postings_(&postings)
+        , segment_count_(postings.SegmentCount())
+        , pending_end_(postings.pending_ids_.size())
+    {
+        LoadSegment(0);
+        Settle();
+    }
+
+void PostingList::Cursor::Next() {
+        if (from_main_) {
+            if (++position_ == segment_size_) {
+                LoadSegment(segment_ + 1);
+            }
+        } else {
+            ++pending_pos_;
+        }
+        Settle();
+    }
+
+void PostingList::Cursor::SkipTo(int document_id) {
+        if (segment_ != segment_count_ && ids_[position_] < document_id) {
+            if (ids_[segment_size_ - 1] < document_id) {
+                size_t segment = segment_count_;
+                if (segment_ + 1 < segment_count_) {
+                    segment = postings_->FindBlock(segment_ + 1, document_id);
+                    if (segment == postings_->blocks_.size() && (postings_->tail_ids_.empty() || postings_->tail_ids_.back() < document_id)) {
+                        segment = segment_count_;
+                    }
+                }
+                LoadSegment(segment);
+            }
+            if (segment_ != segment_count_) {
+                position_ = lower_bound(ids_ + position_, ids_ + segment_size_, document_id) - ids_;
+            }
+        }
+        const auto& pending_ids = postings_->pending_ids_;
+        if (pending_pos_ != pending_end_ && pending_ids[pending_pos_] < document_id) {
+            pending_pos_ = lower_bound(pending_ids.begin() + pending_pos_, pending_ids.end(), document_id) - pending_ids.begin();
+        }
+        Settle();
+    }
+
+void PostingList::Cursor::LoadSegment(size_t segment) {
+        segment_ = segment;
+        position_ = 0;
+        codes_loaded_ = false;
+        if (segment == segment_count_) {
+            segment_size_ = 0;
+        } else if (segment < postings_->blocks_.size()) {
+            const Block& block = postings_->blocks_[segment];
+            postings_->UnpackIds(block, ids_);
+            segment_size_ = block.size;
+        } else {
+            copy(postings_->tail_ids_.begin(), postings_->tail_ids_.end(), ids_);
+            segment_size_ = postings_->tail_ids_.size();
+        }
+    }
+
+uint32_t PostingList::Cursor::MainFreqCode() const {
+        if (!codes_loaded_) {
+            if (segment_ < postings_->blocks_.size()) {
+                postings_->UnpackCodes(postings_->blocks_[segment_], codes_);
+            } else {
+                copy(postings_->tail_codes_.begin(), postings_->tail_codes_.end(), codes_);
+            }
+            codes_loaded_ = true;
+        }
+        return codes_[position_];
+    }
+
+void PostingList::Cursor::Settle() {
+        if (pending_pos_ == pending_end_) {
+            from_main_ = true;
+        } else if (segment_ == segment_count_) {
+            from_main_ = false;
+        } else {
+            from_main_ = ids_[position_] < postings_->pending_ids_[pending_pos_];
+        }
+    }
+
+void PostingList::Add(int document_id, double term_freq) {
+        max_term_freq_ = max(max_term_freq_, term_freq);
+        const uint32_t freq_code = EncodeFreq(term_freq);
+        const int last_id = !tail_ids_.empty() ? tail_ids_.back() : (!blocks_.empty() ? blocks_.back().last_id : -1);
+        if (last_id < document_id) {
+            Append(document_id, freq_code);
+        } else {
+            auto it = lower_bound(pending_ids_.begin(), pending_ids_.end(), document_id);
+            pending_codes_.insert(pending_codes_.begin() + (it - pending_ids_.begin()), freq_code);
+            pending_ids_.insert(it, document_id);
+            if (pending_ids_.size() > MaxPendingSize()) {
+                MergePending();
+            }
+        }
+        if (has_bitmap_) {
+            id_bitmap_.Insert(document_id);
+        }
+        UpdateBitmap();
+    }
+
+void PostingList::AddPostings(const vector<int>& document_ids, const vector<double>& term_freqs) {
+        if (document_ids.empty()) {
+            return;
+        }
+        const int last_id = !tail_ids_.empty() ? tail_ids_.back() : (!blocks_.empty() ? blocks_.back().last_id : -1);
+        if (pending_ids_.empty() && last_id < document_ids.front()) {
+            for (size_t i = 0; i < document_ids.size(); ++i) {
+                max_term_freq_ = max(max_term_freq_, term_freqs[i]);
+                Append(document_ids[i], EncodeFreq(term_freqs[i]));
+                if (has_bitmap_) {
+                    id_bitmap_.Insert(document_ids[i]);
+                }
+            }
+            UpdateBitmap();
+            return;
+        }
+        // Interleaved ids: one merge of both sorted sequences instead of a pending buffer insert per posting
+        vector<int> ids;
+        vector<double> freqs;
+        ids.reserve(Size() + document_ids.size());
+        freqs.reserve(Size() + document_ids.size());
+        size_t i = 0;
+        ForEach([&](int document_id, double term_freq) {
+            for (; i < document_ids.size() && document_ids[i] < document_id; ++i) {
+                ids.push_back(document_ids[i]);
+                freqs.push_back(term_freqs[i]);
+            }
+            ids.push_back(document_id);
+            freqs.push_back(term_freq);
+        });
+        ids.insert(ids.end(), document_ids.begin() + i, document_ids.end());
+        freqs.insert(freqs.end(), term_freqs.begin() + i, term_freqs.end());
+        Rebuild(ids, freqs);
+    }
+
+bool PostingList::Remove(int document_id) {
+        if (!RemovePosting(document_id)) {
+            return false;
+        }
+        CompactBlocks();
+        if (has_bitmap_) {
+            id_bitmap_.Erase(document_id);
+        }
+        UpdateBitmap();
+        return true;
+    }
+
+size_t PostingList::RemovePostings(const vector<int>& document_ids) {
+        // A few removals patch their blocks, many are cheaper as one pass that repacks the list
+        if (document_ids.size() * 16 < Size()) {
+            size_t removed_count = 0;
+            for (const int document_id : document_ids) {
+                if (RemovePosting(document_id)) {
+                    ++removed_count;
+                    if (has_bitmap_) {
+                        id_bitmap_.Erase(document_id);
+                    }
+                }
+            }
+            CompactBlocks();
+            UpdateBitmap();
+            return removed_count;
+        }
+        vector<int> ids;
+        vector<double> freqs;
+        ids.reserve(Size());
+        freqs.reserve(Size());
+        size_t i = 0;
+        ForEach([&](int document_id, double term_freq) {
+            while (i < document_ids.size() && document_ids[i] < document_id) {
+                ++i;
+            }
+            if (i == document_ids.size() || document_ids[i] != document_id) {
+                ids.push_back(document_id);
+                freqs.push_back(term_freq);
+            }
+        });
+        const size_t removed_count = Size() - ids.size();
+        Rebuild(ids, freqs);
+        return removed_count;
+    }
+
+bool PostingList::RemovePosting(int document_id) {
+        const size_t block_index = FindBlock(0, document_id);
+        if (block_index < blocks_.size()) {
+            if (RemoveFromBlock(block_index, document_id)) {
+                --main_size_;
+                return true;
+            }
+        } else {
+            auto it = lower_bound(tail_ids_.begin(), tail_ids_.end(), document_id);
+            if (it != tail_ids_.end() && *it == document_id) {
+                tail_codes_.erase(tail_codes_.begin() + (it - tail_ids_.begin()));
+                tail_ids_.erase(it);
+                --main_size_;
+                return true;
+            }
+        }
+        auto it = lower_bound(pending_ids_.begin(), pending_ids_.end(), document_id);
+        if (it != pending_ids_.end() && *it == document_id) {
+            pending_codes_.erase(pending_codes_.begin() + (it - pending_ids_.begin()));
+            pending_ids_.erase(it);
+            return true;
+        }
+        return false;
+    }
+
+bool PostingList::Contains(int document_id) const {
+        if (has_bitmap_) {
+            return id_bitmap_.Contains(document_id);
+        }
+        const size_t block_index = FindBlock(0, document_id);
+        if (block_index < blocks_.size()) {
+            const Block& block = blocks_[block_index];
+            if (block.first_id <= document_id) {
+                int ids[BIT_PACKED_BLOCK_SIZE];
+                UnpackIds(block, ids);
+                if (binary_search(ids, ids + block.size, document_id)) {
+                    return true;
+                }
+            }
+        } else if (binary_search(tail_ids_.begin(), tail_ids_.end(), document_id)) {
+            return true;
+        }
+        return binary_search(pending_ids_.begin(), pending_ids_.end(), document_id);
+    }
+
+size_t PostingList::GetMemoryUsage() const {
+        return blocks_.capacity() * sizeof(Block) + words_.capacity() * sizeof(uint32_t)
+            + tail_ids_.capacity() * sizeof(int) + tail_codes_.capacity() * sizeof(uint32_t)
+            + pending_ids_.capacity() * sizeof(int) + pending_codes_.capacity() * sizeof(uint32_t)
+            + freq_values_.capacity() * sizeof(double) + sorted_codes_.capacity() * sizeof(uint32_t)
+            + id_bitmap_.GetMemoryUsage();
+    }
+
+uint32_t PostingList::EncodeFreq(double term_freq) {
+        auto it = lower_bound(sorted_codes_.begin(), sorted_codes_.end(), term_freq, [this](uint32_t code, double value) {
+            return freq_values_[code] < value;
+        });
+        if (it != sorted_codes_.end() && freq_values_[*it] == term_freq) {
+            return *it;
+        }
+        const uint32_t freq_code = static_cast<uint32_t>(freq_values_.size());
+        freq_values_.push_back(term_freq);
+        sorted_codes_.insert(it, freq_code);
+        return freq_code;
+    }
+
+void PostingList::Append(int document_id, uint32_t freq_code) {
+        tail_ids_.push_back(document_id);
+        tail_codes_.push_back(freq_code);
+        ++main_size_;
+        if (tail_ids_.size() == BIT_PACKED_BLOCK_SIZE) {
+            blocks_.push_back(PackPostings(tail_ids_.data(), tail_codes_.data(), tail_ids_.size()));
+            tail_ids_.clear();
+            tail_codes_.clear();
+        }
+    }
+
+PostingList::Block PostingList::PackPostings(const int* ids, const uint32_t* codes, size_t size) {
+        uint32_t values[BIT_PACKED_BLOCK_SIZE];
+        EncodeGaps(ids, size, values);
+        Block block;
+        block.first_id = ids[0];
+        block.last_id = ids[size - 1];
+        block.offset = static_cast<uint32_t>(words_.size());
+        block.size = static_cast<uint16_t>(size);
+        block.id_bit_width = static_cast<uint8_t>(RequiredBitWidth(*max_element(values, values + BIT_PACKED_BLOCK_SIZE)));
+        PackBlock(values, block.id_bit_width, words_);
+
+        fill(copy(codes, codes + size, values), values + BIT_PACKED_BLOCK_SIZE, 0);
+        block.code_bit_width = static_cast<uint8_t>(RequiredBitWidth(*max_element(values, values + BIT_PACKED_BLOCK_SIZE)));
+        PackBlock(values, block.code_bit_width, words_);
+        return block;
+    }
+
+void PostingList::UnpackIds(const Block& block, int* ids) const {
+        uint32_t gaps[BIT_PACKED_BLOCK_SIZE];
+        UnpackBlock(words_.data() + block.offset, block.id_bit_width, gaps);
+        DecodeGaps(gaps, block.first_id, ids);
+    }
+
+void PostingList::UnpackCodes(const Block& block, uint32_t* codes) const {
+        UnpackBlock(words_.data() + block.offset + PackedBlockWordCount(block.id_bit_width), block.code_bit_width, codes);
+    }
+
+size_t PostingList::FindBlock(size_t first_block, int document_id) const {
+        return lower_bound(blocks_.begin() + first_block, blocks_.end(), document_id, [](const Block& block, int id) {
+            return block.last_id < id;
+        }) - blocks_.begin();
+    }
+
+bool PostingList::RemoveFromBlock(size_t block_index, int document_id) {
+        Block& block = blocks_[block_index];
+        int ids[BIT_PACKED_BLOCK_SIZE];
+        UnpackIds(block, ids);
+        const size_t position = lower_bound(ids, ids + block.size, document_id) - ids;
+        if (position == block.size || ids[position] != document_id) {
+            return false;
+        }
+        uint32_t codes[BIT_PACKED_BLOCK_SIZE];
+        UnpackCodes(block, codes);
+        copy(ids + position + 1, ids + block.size, ids + position);
+        copy(codes + position + 1, codes + block.size, codes + position);
+        --block.size;
+        if (block.size == 0) {
+            return true;
+        }
+
+        uint32_t gaps[BIT_PACKED_BLOCK_SIZE];
+        EncodeGaps(ids, block.size, gaps);
+        if (RequiredBitWidth(*max_element(gaps, gaps + BIT_PACKED_BLOCK_SIZE)) <= block.id_bit_width) {
+            // Fewer postings never need wider codes, so the block is repacked into its own words
+            codes[block.size] = 0;
+            block.first_id = ids[0];
+            block.last_id = ids[block.size - 1];
+            PackBlock(gaps, block.id_bit_width, words_.data() + block.offset);
+            PackBlock(codes, block.code_bit_width, words_.data() + block.offset + PackedBlockWordCount(block.id_bit_width));
+        } else {
+            // The joined gap needs more bits, the block moves to the end of words_
+            blocks_[block_index] = PackPostings(ids, codes, block.size);
+        }
+        return true;
+    }
+
+void PostingList::CompactBlocks() {
+        size_t word_count = 0;
+        bool has_empty_block = false;
+        for (const Block& block : blocks_) {
+            word_count += PackedBlockWordCount(block.id_bit_width) + PackedBlockWordCount(block.code_bit_width);
+            has_empty_block = has_empty_block || block.size == 0;
+        }
+        if (word_count == words_.size() && !has_empty_block) {
+            return;
+        }
+        vector<uint32_t> words;
+        words.reserve(word_count);
+        for (Block& block : blocks_) {
+            if (block.size > 0) {
+                const auto block_words = words_.begin() + block.offset;
+                const size_t block_word_count = PackedBlockWordCount(block.id_bit_width) + PackedBlockWordCount(block.code_bit_width);
+                block.offset = static_cast<uint32_t>(words.size());
+                words.insert(words.end(), block_words, block_words + block_word_count);
+            }
+        }
+        blocks_.erase(remove_if(blocks_.begin(), blocks_.end(), [](const Block& block) {
+            return block.size == 0;
+        }), blocks_.end());
+        words_ = move(words);
+    }
+
+size_t PostingList::MaxPendingSize() const {
+        // Keeps both the sorted insert into the buffer and the amortized merge cost at O(sqrt(n))
+        return max<size_t>(64, static_cast<size_t>(sqrt(static_cast<double>(main_size_))));
+    }
+
+void PostingList::MergePending() {
+        vector<int> ids;
+        vector<double> freqs;
+        ids.reserve(Size());
+        freqs.reserve(Size());
+        ForEach([&ids, &freqs](int document_id, double term_freq) {
+            ids.push_back(document_id);
+            freqs.push_back(term_freq);
+        });
+        Rebuild(ids, freqs);
+    }
+
+void PostingList::Rebuild(const vector<int>& document_ids, const vector<double>& term_freqs) {
+        // Repacking also drops frequencies of removed documents from the table
+        *this = PostingList();
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            max_term_freq_ = max(max_term_freq_, term_freqs[i]);
+            Append(document_ids[i], EncodeFreq(term_freqs[i]));
+        }
+        blocks_.shrink_to_fit();
+        words_.shrink_to_fit();
+        UpdateBitmap();
+    }
+
+int PostingList::LastId() const {
+        const int last_id = !tail_ids_.empty() ? tail_ids_.back() : (!blocks_.empty() ? blocks_.back().last_id : -1);
+        return pending_ids_.empty() ? last_id : max(last_id, pending_ids_.back());
+    }
+
+void PostingList::UpdateBitmap() {
+        // A bitmap takes LastId() / 8 bytes, dense lists take about 2 bytes per posting anyway.
+        // The gap between the thresholds keeps a list near one of them from rebuilding every time
+        static const size_t MIN_BITMAP_SIZE = 1024;
+        const size_t id_count = static_cast<size_t>(LastId() + 1);
+        if (!has_bitmap_ && Size() >= MIN_BITMAP_SIZE && Size() * 16 >= id_count) {
+            ForEach([this](int document_id, double term_freq) {
+                id_bitmap_.Insert(document_id);
+            });
+            has_bitmap_ = true;
+        } else if (has_bitmap_ && (Size() < MIN_BITMAP_SIZE / 2 || Size() * 32 < id_count)) {
+            id_bitmap_ = DocumentBitmap();
+            has_bitmap_ = false;
+        }
+    }
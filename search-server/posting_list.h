@@ -0,0 +1,178 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include "bit_packing.h"
+#include "document_bitmap.h"
+
+// Postings of a single term: document ids in ascending order and their term frequencies.
+// Postings are kept in blocks of BIT_PACKED_BLOCK_SIZE: ids as bit-packed gaps, frequencies
+// as bit-packed codes into the table of distinct frequencies of the list, so they stay exact.
+// The newest postings stay unpacked in a tail until it fills a whole block.
+// Documents added out of id order go to a small sorted write buffer that is
+// merged into the blocks once it outgrows MaxPendingSize().
+// Dense lists also keep a bitmap of their ids for O(1) membership tests.
+class PostingList {
+public:
+    // Forward cursor over the merged (blocks + tail + write buffer) id order.
+    // Decodes one block at a time, frequencies only when asked for
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList& postings);
+
+        bool IsEnd() const {
+            return segment_ == segment_count_ && pending_pos_ == pending_end_;
+        }
+
+        int DocumentId() const {
+            return from_main_ ? ids_[position_] : postings_->pending_ids_[pending_pos_];
+        }
+
+        double TermFreq() const {
+            return postings_->freq_values_[from_main_ ? MainFreqCode() : postings_->pending_codes_[pending_pos_]];
+        }
+
+        void Next();
+
+        // Moves to the first posting with id >= document_id, skips whole blocks by their last id
+        void SkipTo(int document_id);
+
+    private:
+        const PostingList* postings_;
+        // Segments are the blocks followed by the tail, segment_count_ means the end
+        size_t segment_ = 0;
+        size_t segment_count_ = 0;
+        size_t segment_size_ = 0;
+        size_t position_ = 0;
+        size_t pending_pos_ = 0;
+        size_t pending_end_ = 0;
+        bool from_main_ = true;
+        mutable bool codes_loaded_ = false;
+        int ids_[BIT_PACKED_BLOCK_SIZE];
+        mutable uint32_t codes_[BIT_PACKED_BLOCK_SIZE];
+
+        void LoadSegment(size_t segment);
+
+        uint32_t MainFreqCode() const;
+
+        void Settle();
+    };
+
+    Cursor GetCursor() const {
+        return Cursor(*this);
+    }
+
+    // document_id must not be present yet
+    void Add(int document_id, double term_freq);
+
+    // Bulk Add, document_ids must be ascending and not present yet
+    void AddPostings(const std::vector<int>& document_ids, const std::vector<double>& term_freqs);
+
+    // Returns false if there was no such document
+    bool Remove(int document_id);
+
+    // Bulk Remove, document_ids must be ascending. Returns the number of removed postings
+    size_t RemovePostings(const std::vector<int>& document_ids);
+
+    bool Contains(int document_id) const;
+
+    // Bitmap of the ids while the list is dense enough to afford it (every 16th id or more),
+    // nullptr otherwise
+    const DocumentBitmap* GetBitmap() const {
+        return has_bitmap_ ? &id_bitmap_ : nullptr;
+    }
+
+    size_t Size() const {
+        return main_size_ + pending_ids_.size();
+    }
+
+    bool Empty() const {
+        return Size() == 0;
+    }
+
+    // Upper bound of the term frequencies in the list, exact until documents are removed
+    double MaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    // Heap memory held by the list in bytes
+    size_t GetMemoryUsage() const;
+
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    struct Block {
+        int first_id;
+        int last_id;
+        // Position in words_: the packed gaps followed by the packed frequency codes
+        uint32_t offset;
+        uint16_t size;
+        uint8_t id_bit_width;
+        uint8_t code_bit_width;
+    };
+
+    std::vector<Block> blocks_;
+    std::vector<uint32_t> words_;
+    std::vector<int> tail_ids_;
+    std::vector<uint32_t> tail_codes_;
+    size_t main_size_ = 0;
+
+    std::vector<int> pending_ids_;
+    std::vector<uint32_t> pending_codes_;
+
+    // Distinct frequencies by code and codes ordered by frequency
+    std::vector<double> freq_values_;
+    std::vector<uint32_t> sorted_codes_;
+    double max_term_freq_ = 0.0;
+
+    DocumentBitmap id_bitmap_;
+    bool has_bitmap_ = false;
+
+    uint32_t EncodeFreq(double term_freq);
+
+    void Append(int document_id, uint32_t freq_code);
+
+    // Packs size postings (at most a block) to the end of words_
+    Block PackPostings(const int* ids, const uint32_t* codes, size_t size);
+
+    void UnpackIds(const Block& block, int* ids) const;
+
+    void UnpackCodes(const Block& block, uint32_t* codes) const;
+
+    size_t SegmentCount() const {
+        return blocks_.size() + (tail_ids_.empty() ? 0 : 1);
+    }
+
+    // First block with last id >= document_id starting from first_block, blocks_.size() for the tail
+    size_t FindBlock(size_t first_block, int document_id) const;
+
+    bool RemovePosting(int document_id);
+
+    // Repacks the block in place unless its ids need a wider packing, then it moves to the end
+    // of words_. An emptied block stays until CompactBlocks
+    bool RemoveFromBlock(size_t block_index, int document_id);
+
+    // Drops emptied blocks and the words no block uses, once after a round of removals
+    void CompactBlocks();
+
+    size_t MaxPendingSize() const;
+
+    int LastId() const;
+
+    // Builds or drops the bitmap when the density crosses the thresholds
+    void UpdateBitmap();
+
+    void MergePending();
+
+    // Repacks the list from postings in id order
+    void Rebuild(const std::vector<int>& document_ids, const std::vector<double>& term_freqs);
+};
+
+template <typename Function>
+    void PostingList::ForEach(Function function) const {
+        for (auto cursor = GetCursor(); !cursor.IsEnd(); cursor.Next()) {
+            function(cursor.DocumentId(), cursor.TermFreq());
+        }
+    }
@@ -0,0 +1,25 @@
+#include "query_control.h"
+
+using namespace std;
+
+QueryControl::QueryControl(Clock::time_point deadline)
+        : deadline_(deadline)
+    {
+    }
+
+QueryControl::QueryControl(Clock::duration timeout)
+        : QueryControl(Clock::now() + timeout)
+    {
+    }
+
+void QueryControl::Cancel() {
+        is_cancelled_.store(true, memory_order_relaxed);
+    }
+
+bool QueryControl::IsCancelled() const {
+        return is_cancelled_.load(memory_order_relaxed);
+    }
+
+bool QueryControl::ShouldStop() const {
+        return IsCancelled() || (deadline_ != Clock::time_point::max() && Clock::now() >= deadline_);
+    }
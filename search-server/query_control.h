@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include "document.h"
+
+// Deadline and cancellation of a running query. Scoring checks it every few hundred candidates
+// and stops there, so a query made of very common words can't hold a thread past its deadline.
+// Cancel may be called from any thread
+class QueryControl {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Neither deadline nor cancellation until Cancel
+    QueryControl() = default;
+
+    explicit QueryControl(Clock::time_point deadline);
+
+    explicit QueryControl(Clock::duration timeout);
+
+    void Cancel();
+
+    bool IsCancelled() const;
+
+    // Cancelled or past the deadline
+    bool ShouldStop() const;
+
+private:
+    std::atomic<bool> is_cancelled_ = false;
+    Clock::time_point deadline_ = Clock::time_point::max();
+};
+
+// Results of a query that may have been stopped: then documents are the top of the documents
+// scored until that moment, which come in index order
+struct SearchResult {
+    std::vector<Document> documents;
+    bool is_complete = true;
+};
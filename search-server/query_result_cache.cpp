@@ -0,0 +1,95 @@
+#include "query_result_cache.h"
+
+using namespace std;
+
+QueryResultCache::QueryResultCache(const SearchServer& search_server, size_t capacity)
+        : search_server_(search_server)
+        , capacity_(capacity)
+        , generation_(search_server.GetGeneration())
+    {
+    }
+
+vector<Document> QueryResultCache::FindTopDocuments(const string_view raw_query, DocumentStatus status, size_t top_k) {
+        // Throws for invalid queries before anything is counted
+        const string key = MakeKey(raw_query, status, top_k);
+        {
+            lock_guard guard(mutex_);
+            Revalidate();
+            const auto it = key_to_entry_.find(key);
+            if (it != key_to_entry_.end()) {
+                ++hit_count_;
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return it->second->documents;
+            }
+            ++miss_count_;
+        }
+
+        // Computed without the lock, so misses of different queries don't wait for each other
+        const uint64_t generation = search_server_.GetGeneration();
+        vector<Document> documents = search_server_.FindTopDocuments(raw_query, status, top_k);
+        if (capacity_ == 0) {
+            return documents;
+        }
+
+        lock_guard guard(mutex_);
+        Revalidate();
+        if (generation != generation_ || key_to_entry_.count(key) > 0) {
+            return documents;
+        }
+        entries_.push_front({key, documents});
+        key_to_entry_.emplace(entries_.front().key, entries_.begin());
+        if (entries_.size() > capacity_) {
+            key_to_entry_.erase(entries_.back().key);
+            entries_.pop_back();
+        }
+        return documents;
+    }
+
+vector<Document> QueryResultCache::FindTopDocuments(const string_view raw_query) {
+        return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+    }
+
+size_t QueryResultCache::GetHitCount() const {
+        lock_guard guard(mutex_);
+        return hit_count_;
+    }
+
+size_t QueryResultCache::GetMissCount() const {
+        lock_guard guard(mutex_);
+        return miss_count_;
+    }
+
+size_t QueryResultCache::GetSize() const {
+        lock_guard guard(mutex_);
+        return entries_.size();
+    }
+
+void QueryResultCache::Clear() {
+        lock_guard guard(mutex_);
+        key_to_entry_.clear();
+        entries_.clear();
+    }
+
+string QueryResultCache::MakeKey(const string_view raw_query, DocumentStatus status, size_t top_k) const {
+        // Words have no spaces and plus words never start with '-', so the key is unambiguous
+        const QueryWords query_words = search_server_.NormalizeQuery(raw_query);
+        string key = to_string(static_cast<int>(status)) + ' ' + to_string(top_k);
+        for (const string_view word : query_words.plus_words) {
+            key += ' ';
+            key += word;
+        }
+        for (const string_view word : query_words.minus_words) {
+            key += " -";
+            key += word;
+        }
+        return key;
+    }
+
+void QueryResultCache::Revalidate() {
+        const uint64_t generation = search_server_.GetGeneration();
+        if (generation != generation_) {
+            key_to_entry_.clear();
+            entries_.clear();
+            generation_ = generation;
+        }
+    }
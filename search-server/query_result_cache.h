@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include "document.h"
+#include "search_server.h"
+
+// Size-bounded LRU cache of FindTopDocuments results in front of a SearchServer.
+// Entries are keyed by the normalized query, the status and top_k, so reordered or repeated
+// words share an entry. Any change of the index moves IDF and so every relevance,
+// which is why the whole cache is dropped once the generation of the server changes.
+// Arbitrary predicates can't be compared, they go to the server uncached
+class QueryResultCache {
+public:
+    QueryResultCache(const SearchServer& search_server, size_t capacity);
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT);
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query);
+
+    size_t GetHitCount() const ;
+
+    size_t GetMissCount() const ;
+
+    size_t GetSize() const ;
+
+    void Clear();
+
+private:
+    struct Entry {
+        std::string key;
+        std::vector<Document> documents;
+    };
+
+    const SearchServer& search_server_;
+    const size_t capacity_;
+    uint64_t generation_;
+
+    // Most recently used first, the index keys point into the entry keys
+    std::list<Entry> entries_;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> key_to_entry_;
+
+    size_t hit_count_ = 0;
+    size_t miss_count_ = 0;
+    mutable std::mutex mutex_;
+
+    std::string MakeKey(const std::string_view raw_query, DocumentStatus status, size_t top_k) const ;
+
+    // Drops everything computed under an older generation of the index, mutex_ must be held
+    void Revalidate();
+};
@@ -1,39 +1,156 @@
 #include "remove_duplicates.h"
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <execution>
+#include <cstdint>
+#include <limits>
+#include "thread_pool.h"
 
 using namespace std;
 
-#include <sstream>
-template<typename T>
-ostream& operator<<(ostream& out, const set<T> s) {
-    cout << "{"s;
-    for (auto e : s) {
-        out << e << ", "s; 
+using TermFrequencies = vector<SearchServer::TermFrequency>;
+
+uint64_t MixHash(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+// Sum of the mixed term ids, so it doesn't depend on the order of the terms
+uint64_t ComputeFingerprint(const TermFrequencies& term_freqs) {
+    uint64_t fingerprint = MixHash(term_freqs.size());
+    for (const auto& term_freq : term_freqs) {
+        fingerprint += MixHash(term_freq.term_id);
     }
-    cout << "}"s << endl;
-    return out;
+    return fingerprint;
 }
 
-void RemoveDuplicates(SearchServer& search_server) {
-    map<set<string>, vector<int>> words_for_doc;
-    //здесь приведу мой рассчёт сложности, скажите где ошибка если не правильно посчитаю
-    for (const int id : search_server) { //сложность n
-        set<string> words;
-        for(const auto& [word, freq] : search_server.GetWordFrequencies(id)) { //второй for в котором есть функция слоностью log(n) и в худшем случае перебор по w слов
-            words.insert((string)word); //здесь будет амортизированная константная сложность, так как в начале сложности будут log(1), log(2), log(3), ... и только последние случаи будут log(w-2), log(w-1), log(w) 
+bool HaveSameTerms(const TermFrequencies& lhs, const TermFrequencies& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const auto& lhs_term, const auto& rhs_term) {
+        return lhs_term.term_id == rhs_term.term_id;
+    });
+}
+
+// Both lists are ordered by term id
+double ComputeJaccardSimilarity(const TermFrequencies& lhs, const TermFrequencies& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t common = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+        if (lhs_it->term_id < rhs_it->term_id) {
+            ++lhs_it;
+        } else if (rhs_it->term_id < lhs_it->term_id) {
+            ++rhs_it;
+        } else {
+            ++common;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return static_cast<double>(common) / static_cast<double>(lhs.size() + rhs.size() - common);
+}
+
+vector<int> FindDuplicates(const SearchServer& search_server) {
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        vector<const TermFrequencies*> documents(document_ids.size());
+        vector<uint64_t> fingerprints(document_ids.size());
+        ForEachIndex(execution::par, search_server.GetExecutor(), document_ids.size(), [&](size_t index) {
+            documents[index] = &search_server.GetTermFrequencies(document_ids[index]);
+            fingerprints[index] = ComputeFingerprint(*documents[index]);
+        });
+
+        // Kept documents by fingerprint, a bucket holds several only on collisions
+        unordered_map<uint64_t, vector<size_t>> kept_documents;
+        kept_documents.reserve(document_ids.size());
+        vector<int> duplicates;
+        for (size_t index = 0; index < document_ids.size(); ++index) {
+            auto& bucket = kept_documents[fingerprints[index]];
+            const bool is_duplicate = any_of(bucket.begin(), bucket.end(), [&](size_t kept) {
+                return HaveSameTerms(*documents[kept], *documents[index]);
+            });
+            if (is_duplicate) {
+                duplicates.push_back(document_ids[index]);
+            } else {
+                bucket.push_back(index);
+            }
+        }
+        return duplicates;
+    }
+
+vector<int> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options) {
+        const size_t band_count = max<size_t>(options.band_count, 1);
+        const size_t rows_per_band = max<size_t>(options.rows_per_band, 1);
+        const size_t hash_count = band_count * rows_per_band;
+        vector<uint64_t> seeds(hash_count);
+        for (size_t i = 0; i < hash_count; ++i) {
+            seeds[i] = MixHash(i + 1);
         }
-        words_for_doc[words].push_back(id); //вставка в вектор амортизированная константная сложность, только уже только уже в худших случаях будет n-2, n-1, n
-        //и доступ к элементу map или создание нового это тоже амортизированная константная сложность, так как в начале будет log(1), log(2), log(3), ... и только последние случаи будут log(n-2), log(n-1), log(n) 
-    }//итоговая будет что-то типа n*(w*log(n)) 
-
-    //я не уверен, что прошёл по сложности, но мне кажеться что она здесь не n^2, а k*(n-k) k - любое чило из диапазона [1..n)
-    //если у нас в певром for попало n докуметов, то во втором for будет все векторы равны 1, то есть сложность n*1
-    //если в первом for попало k = [1..n-1], то в худшем случае второй for сделает n-k операций 
-    for(const auto& [words, ids] : words_for_doc) {
-        if (ids.size() != 1) {
-            for (auto it = ids.begin() + 1; it != ids.end(); ++it) {
-                cout << "Found duplicate document id "s << *it << endl;
-                search_server.RemoveDocument(*it);
+
+        // Only the hashes of the bands are kept, not the signatures
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        vector<const TermFrequencies*> documents(document_ids.size());
+        vector<uint64_t> band_keys(document_ids.size() * band_count);
+        ForEachIndex(execution::par, search_server.GetExecutor(), document_ids.size(), [&](size_t index) {
+            documents[index] = &search_server.GetTermFrequencies(document_ids[index]);
+            vector<uint64_t> signature(hash_count, numeric_limits<uint64_t>::max());
+            for (const auto& term_freq : *documents[index]) {
+                for (size_t i = 0; i < hash_count; ++i) {
+                    signature[i] = min(signature[i], MixHash(term_freq.term_id ^ seeds[i]));
+                }
+            }
+            for (size_t band = 0; band < band_count; ++band) {
+                uint64_t key = MixHash(band);
+                for (size_t row = 0; row < rows_per_band; ++row) {
+                    key = MixHash(key ^ signature[band * rows_per_band + row]);
+                }
+                band_keys[index * band_count + band] = key;
+            }
+        });
+
+        // Kept documents by band and band key
+        vector<unordered_map<uint64_t, vector<size_t>>> bands(band_count);
+        vector<size_t> candidates;
+        vector<int> duplicates;
+        for (size_t index = 0; index < document_ids.size(); ++index) {
+            candidates.clear();
+            for (size_t band = 0; band < band_count; ++band) {
+                const auto it = bands[band].find(band_keys[index * band_count + band]);
+                if (it != bands[band].end()) {
+                    candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+                }
+            }
+            sort(candidates.begin(), candidates.end());
+            candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+            const bool is_duplicate = any_of(candidates.begin(), candidates.end(), [&](size_t kept) {
+                return ComputeJaccardSimilarity(*documents[kept], *documents[index]) >= options.min_similarity;
+            });
+            if (is_duplicate) {
+                duplicates.push_back(document_ids[index]);
+                continue;
+            }
+            for (size_t band = 0; band < band_count; ++band) {
+                bands[band][band_keys[index * band_count + band]].push_back(index);
             }
         }
+        return duplicates;
+    }
+
+void RemoveFoundDuplicates(SearchServer& search_server, const vector<int>& duplicates) {
+        for (const int document_id : duplicates) {
+            cout << "Found duplicate document id "s << document_id << endl;
+        }
+        search_server.RemoveDocuments(execution::par, duplicates);
+    }
+
+void RemoveDuplicates(SearchServer& search_server) {
+        RemoveFoundDuplicates(search_server, FindDuplicates(search_server));
+    }
+
+void RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options) {
+        RemoveFoundDuplicates(search_server, FindNearDuplicates(search_server, options));
     }
-}
\ No newline at end of file
@@ -1,8 +1,28 @@
 #pragma once
 #include "document.h"
 #include "search_server.h"
-#include <set>
-#include <map>
-#include <iostream>
+#include <vector>
+#include <cstddef>
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+// Ids of the documents with the same set of words as a document with a smaller id, ascending.
+// Word sets are compared by an order-independent 64-bit fingerprint computed in parallel,
+// term lists are compared exactly only for documents with equal fingerprints
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+
+// MinHash signatures of the word sets cut into band_count bands of rows_per_band hashes;
+// documents sharing a band are candidates and are kept if their Jaccard similarity is at
+// least min_similarity. The defaults find pairs with similarity 0.8 with probability 0.9996
+struct NearDuplicateOptions {
+    double min_similarity = 0.8;
+    size_t band_count = 20;
+    size_t rows_per_band = 5;
+};
+
+// Ids of the documents similar to a kept document with a smaller id, ascending.
+// A document that is not a near-duplicate itself is kept, so chains of similar documents
+// don't remove documents unlike everything that stays
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options = {});
+
+void RemoveDuplicates(SearchServer& search_server);
+
+void RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options = {});
@@ -22,6 +22,12 @@ vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
         return answer;
     }
 
+SearchResult RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status, const QueryControl& control) {
+        auto answer = server_.FindTopDocuments(control, raw_query, status);
+        collecting_statistics(answer.documents);
+        return answer;
+    }
+
 int RequestQueue::GetNoResultRequests() const {
         // напишите реализацию
         return number_empty_requests;
@@ -15,6 +15,9 @@ public:
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status) ;
     
     std::vector<Document> AddFindRequest(const std::string& raw_query) ;
+
+    // Request with a deadline or cancellation, a stopped request counts with its partial results
+    SearchResult AddFindRequest(const std::string& raw_query, DocumentStatus status, const QueryControl& control) ;
     
     int GetNoResultRequests() const ;
     
@@ -1,4 +1,5 @@
 #include "search_server.h"
+#include <fstream>
 
 using namespace std;
 
@@ -8,6 +9,10 @@ void SearchServer::RemoveDocument(int document_id) {
     RemoveDocument(execution::seq, document_id);
 }
 
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    RemoveDocuments(execution::seq, document_ids);
+}
+
 SearchServer::SearchServer(const string_view stop_words_text)
         : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
     {
@@ -26,44 +31,437 @@ set<int>::const_iterator SearchServer::end() const{
     return document_ids_.end();
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const{
-    static map<std::string_view, double> empty;
-    if (id_to_word_freqs_.count(document_id)) {
-        return id_to_word_freqs_.at(document_id);   
+const vector<SearchServer::TermFrequency>& SearchServer::GetTermFrequencies(int document_id) const{
+    static const vector<TermFrequency> empty;
+    const auto it = id_to_ordinal_.find(document_id);
+    if (it != id_to_ordinal_.end()) {
+        return ordinal_term_freqs_[it->second];
     } else {
         return empty;
     }
 }
 
+map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const{
+    map<string_view, double> word_freqs;
+    for (const auto [term_id, freq] : GetTermFrequencies(document_id)) {
+        word_freqs.emplace(terms_.GetTerm(term_id), freq);
+    }
+    return word_freqs;
+}
+
+string_view SearchServer::GetTerm(uint32_t term_id) const {
+    return terms_.GetTerm(term_id);
+}
+
+const set<string, less<>>& SearchServer::GetStopWords() const {
+    return stop_words_;
+}
+
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
-        if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+        if ((document_id < 0) || (id_to_ordinal_.count(document_id) > 0)) {
             throw invalid_argument("Invalid document_id"s);
         }
-        const auto words = SplitIntoWordsNoStop(document);
+        vector<string_view> words;
+        SplitIntoWordsNoStop(document, words);
 
         const double inv_word_count = 1.0 / words.size();
+        map<uint32_t, double> term_freqs;
         for (const string_view word : words) {
-            word_to_document_freqs_[(string)word][document_id] += inv_word_count;
-            string_view str_in_map = word_to_document_freqs_.find((string)word)->first;
-            id_to_word_freqs_[document_id][str_in_map] += inv_word_count;
+            term_freqs[terms_.Intern(word)] += inv_word_count;
+        }
+        IndexDocument(document_id, term_freqs, status, ComputeAverageRating(ratings));
+    }
+
+void SearchServer::AddIndexedDocument(int document_id, const map<string_view, double>& word_freqs, DocumentStatus status, int rating) {
+        if ((document_id < 0) || (id_to_ordinal_.count(document_id) > 0)) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        map<uint32_t, double> term_freqs;
+        for (const auto [word, term_freq] : word_freqs) {
+            term_freqs.emplace(terms_.Intern(word), term_freq);
+        }
+        IndexDocument(document_id, term_freqs, status, rating);
+    }
+
+SearchServer::TokenizedDocument SearchServer::TokenizeDocument(const NewDocument& document) const {
+        // Bulk ingest tokenizes many documents per thread, the buffer is reused between them
+        static thread_local vector<string_view> words;
+        SplitIntoWordsNoStop(document.text, words);
+        const double inv_word_count = 1.0 / words.size();
+        sort(words.begin(), words.end());
+
+        TokenizedDocument result;
+        result.id = document.id;
+        result.status = document.status;
+        for (size_t begin = 0, end = 0; begin < words.size(); begin = end) {
+            // Same summation as in AddDocument, so frequencies are bit-identical
+            double term_freq = 0.0;
+            for (end = begin; end < words.size() && words[end] == words[begin]; ++end) {
+                term_freq += inv_word_count;
+            }
+            result.word_freqs.push_back({words[begin], term_freq});
         }
-        documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+        result.rating = ComputeAverageRating(document.ratings);
+        return result;
+    }
+
+void SearchServer::ValidateNewDocumentIds(const vector<TokenizedDocument>& documents) const {
+        vector<int> document_ids;
+        document_ids.reserve(documents.size());
+        for (const TokenizedDocument& document : documents) {
+            if ((document.id < 0) || (id_to_ordinal_.count(document.id) > 0)) {
+                throw invalid_argument("Invalid document_id"s);
+            }
+            document_ids.push_back(document.id);
+        }
+        sort(document_ids.begin(), document_ids.end());
+        if (adjacent_find(document_ids.begin(), document_ids.end()) != document_ids.end()) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+    }
+
+vector<SearchServer::TermPostingsUpdate> SearchServer::IndexTokenizedDocuments(const vector<TokenizedDocument>& documents) {
+        const int first_ordinal = static_cast<int>(ordinal_ids_.size());
+        for (const TokenizedDocument& document : documents) {
+            vector<TermFrequency> term_freqs;
+            term_freqs.reserve(document.word_freqs.size());
+            for (const auto& [word, term_freq] : document.word_freqs) {
+                term_freqs.push_back({terms_.Intern(word), term_freq});
+            }
+            sort(term_freqs.begin(), term_freqs.end(), [](const TermFrequency& lhs, const TermFrequency& rhs) {
+                return lhs.term_id < rhs.term_id;
+            });
+            AddDocumentData(document.id, document.status, document.rating, move(term_freqs));
+        }
+        term_postings_.resize(terms_.Size());
+        ++generation_;
+
+        // The batch got ascending ordinals, so one pass over it gives every term its new postings already sorted
+        static const size_t NO_UPDATE = SIZE_MAX;
+        vector<size_t> term_updates(terms_.Size(), NO_UPDATE);
+        vector<TermPostingsUpdate> updates;
+        for (int ordinal = first_ordinal; ordinal < static_cast<int>(ordinal_ids_.size()); ++ordinal) {
+            for (const auto [term_id, term_freq] : ordinal_term_freqs_[ordinal]) {
+                if (term_updates[term_id] == NO_UPDATE) {
+                    term_updates[term_id] = updates.size();
+                    updates.push_back({term_id, {}, {}});
+                }
+                auto& update = updates[term_updates[term_id]];
+                update.ordinals.push_back(ordinal);
+                update.term_freqs.push_back(term_freq);
+            }
+        }
+        return updates;
+    }
+
+vector<SearchServer::TermRemovals> SearchServer::UnindexDocuments(const vector<int>& document_ids) {
+        // Term id and ordinal packed into one key, sorting the keys groups postings by term in ordinal order
+        vector<uint64_t> postings;
+        for (const int document_id : document_ids) {
+            const auto it = id_to_ordinal_.find(document_id);
+            if (it == id_to_ordinal_.end()) {
+                continue;
+            }
+            const int ordinal = it->second;
+            for (const auto [term_id, term_freq] : ordinal_term_freqs_[ordinal]) {
+                postings.push_back(static_cast<uint64_t>(term_id) << 32 | static_cast<uint32_t>(ordinal));
+            }
+            ordinal_ids_[ordinal] = NO_DOCUMENT;
+            for (DocumentBitmap& status_bitmap : status_bitmaps_) {
+                status_bitmap.Erase(ordinal);
+            }
+            vector<TermFrequency>().swap(ordinal_term_freqs_[ordinal]);
+            ++removed_ordinal_count_;
+            id_to_ordinal_.erase(it);
+            document_ids_.erase(document_id);
+            ++generation_;
+        }
+        sort(postings.begin(), postings.end());
+
+        vector<TermRemovals> removals;
+        for (const uint64_t posting : postings) {
+            const uint32_t term_id = static_cast<uint32_t>(posting >> 32);
+            if (removals.empty() || removals.back().term_id != term_id) {
+                removals.push_back({term_id, {}});
+            }
+            removals.back().ordinals.push_back(static_cast<int>(static_cast<uint32_t>(posting)));
+        }
+        return removals;
+    }
+
+void SearchServer::IndexDocument(int document_id, const map<uint32_t, double>& term_freqs, DocumentStatus status, int rating) {
+        term_postings_.resize(terms_.Size());
+
+        vector<TermFrequency> document_term_freqs;
+        document_term_freqs.reserve(term_freqs.size());
+        for (const auto [term_id, term_freq] : term_freqs) {
+            document_term_freqs.push_back({term_id, term_freq});
+        }
+        const int ordinal = AddDocumentData(document_id, status, rating, move(document_term_freqs));
+        for (const auto [term_id, term_freq] : ordinal_term_freqs_[ordinal]) {
+            term_postings_[term_id].Add(ordinal, term_freq);
+        }
+        ++generation_;
+    }
+
+int SearchServer::AddDocumentData(int document_id, DocumentStatus status, int rating, vector<TermFrequency> term_freqs) {
+        const int ordinal = static_cast<int>(ordinal_ids_.size());
+        ordinal_ids_.push_back(document_id);
+        ordinal_ratings_.push_back(rating);
+        ordinal_statuses_.push_back(status);
+        ordinal_term_freqs_.push_back(move(term_freqs));
+        if (static_cast<size_t>(status) < STATUS_COUNT) {
+            status_bitmaps_[static_cast<size_t>(status)].Insert(ordinal);
+        }
+        id_to_ordinal_.emplace(document_id, ordinal);
         document_ids_.insert(document_id);
+        return ordinal;
+    }
+
+int SearchServer::GetOrdinal(int document_id) const {
+        return id_to_ordinal_.at(document_id);
+    }
+
+const DocumentBitmap& SearchServer::GetStatusBitmap(DocumentStatus status) const {
+        static const DocumentBitmap empty;
+        return static_cast<size_t>(status) < STATUS_COUNT ? status_bitmaps_[static_cast<size_t>(status)] : empty;
     }
 
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(
-            raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
+void SearchServer::CompactOrdinals() {
+        vector<int> new_ordinals(ordinal_ids_.size(), NO_DOCUMENT);
+        int ordinal_count = 0;
+        for (size_t ordinal = 0; ordinal < ordinal_ids_.size(); ++ordinal) {
+            const int document_id = ordinal_ids_[ordinal];
+            if (document_id == NO_DOCUMENT) {
+                continue;
+            }
+            new_ordinals[ordinal] = ordinal_count;
+            // Documents before the first hole stay in place, moving a vector onto itself would empty it
+            if (static_cast<size_t>(ordinal_count) != ordinal) {
+                ordinal_ids_[ordinal_count] = document_id;
+                ordinal_ratings_[ordinal_count] = ordinal_ratings_[ordinal];
+                ordinal_statuses_[ordinal_count] = ordinal_statuses_[ordinal];
+                ordinal_term_freqs_[ordinal_count] = move(ordinal_term_freqs_[ordinal]);
+                id_to_ordinal_[document_id] = ordinal_count;
+            }
+            ++ordinal_count;
+        }
+        ordinal_ids_.resize(ordinal_count);
+        ordinal_ratings_.resize(ordinal_count);
+        ordinal_statuses_.resize(ordinal_count);
+        ordinal_term_freqs_.resize(ordinal_count);
+        removed_ordinal_count_ = 0;
+        for (DocumentBitmap& status_bitmap : status_bitmaps_) {
+            status_bitmap.Clear();
+        }
+        for (int ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+            if (static_cast<size_t>(ordinal_statuses_[ordinal]) < STATUS_COUNT) {
+                status_bitmaps_[static_cast<size_t>(ordinal_statuses_[ordinal])].Insert(ordinal);
+            }
+        }
+
+        // Renumbering keeps the order, so the postings stay sorted
+        vector<int> ordinals;
+        vector<double> term_freqs;
+        for (PostingList& postings : term_postings_) {
+            ordinals.clear();
+            term_freqs.clear();
+            postings.ForEach([&](int ordinal, double term_freq) {
+                ordinals.push_back(new_ordinals[ordinal]);
+                term_freqs.push_back(term_freq);
             });
+            postings = PostingList();
+            postings.AddPostings(ordinals, term_freqs);
+        }
+    }
+
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status, size_t top_k) const {
+        return FindTopDocuments(execution::seq, raw_query, status, top_k);
     }
 
 vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) const {
         return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
     }
 
+const vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, const string_view raw_query, DocumentStatus status, size_t top_k) const {
+        return FindMaskedDocuments(context, raw_query, GetStatusBitmap(status), [](int document_id, DocumentStatus document_status, int rating) {
+            return true;
+        }, top_k);
+    }
+
+const vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, const string_view raw_query) const {
+        return FindTopDocuments(context, raw_query, DocumentStatus::ACTUAL);
+    }
+
+SearchServer::ResultPage SearchServer::FindTopDocumentsPage(const string_view raw_query, DocumentStatus status, size_t page_size, const PageCursor& cursor) const {
+        return FindTopDocumentsPage(execution::seq, raw_query, status, page_size, cursor);
+    }
+
+SearchResult SearchServer::FindTopDocuments(const QueryControl& control, const string_view raw_query, DocumentStatus status, size_t top_k) const {
+        SearchResult result;
+        if (control.ShouldStop()) {
+            result.is_complete = false;
+            return result;
+        }
+        QueryContext context;
+        ParseQuery(raw_query, true, context);
+        result.is_complete = FindDocumentsInRange(context.query_, GetStatusBitmap(status), [](int document_id, DocumentStatus document_status, int rating) {
+            return true;
+        }, top_k, 0, INT_MAX, context, nullptr, [&control]() {
+            return control.ShouldStop();
+        });
+        result.documents = context.top_documents_.Extract();
+        return result;
+    }
+
+future<SearchResult> SearchServer::FindTopDocumentsAsync(string raw_query, shared_ptr<const QueryControl> control, DocumentStatus status, size_t top_k) const {
+        auto result = make_shared<promise<SearchResult>>();
+        auto future = result->get_future();
+        GetExecutor().Submit([this, result, raw_query = move(raw_query), control = move(control), status, top_k]() {
+            const QueryControl no_limits;
+            try {
+                result->set_value(FindTopDocuments(control ? *control : no_limits, raw_query, status, top_k));
+            } catch (...) {
+                result->set_exception(current_exception());
+            }
+        });
+        return future;
+    }
+
 int SearchServer::GetDocumentCount() const {
-        return documents_.size();
+        return document_ids_.size();
+    }
+
+int SearchServer::GetDocumentRating(int document_id) const {
+        return ordinal_ratings_[GetOrdinal(document_id)];
+    }
+
+DocumentStatus SearchServer::GetDocumentStatus(int document_id) const {
+        return ordinal_statuses_[GetOrdinal(document_id)];
+    }
+
+bool SearchServer::HasDocument(int document_id) const {
+        return id_to_ordinal_.count(document_id) > 0;
+    }
+
+void SearchServer::SetCorpusStatistics(shared_ptr<const CorpusStatistics> corpus_statistics) {
+    corpus_statistics_ = move(corpus_statistics);
+    ++generation_;
+}
+
+void SearchServer::SetExecutor(shared_ptr<ThreadPool> executor) {
+    executor_ = move(executor);
+}
+
+ThreadPool& SearchServer::GetExecutor() const {
+        return executor_ ? *executor_ : ThreadPool::GetDefault();
+    }
+
+uint64_t SearchServer::GetGeneration() const {
+        // Both counters only grow, so the sum changes whenever either does
+        return generation_ + (corpus_statistics_ ? corpus_statistics_->GetGeneration() : 0);
+    }
+
+QueryWords SearchServer::NormalizeQuery(const string_view raw_query) const {
+        return ParseQueryWords(raw_query, true, [this](const string_view word) {
+            return IsStopWord(word);
+        });
+    }
+
+void SearchServer::SaveIndex(const string& path) const {
+        // Terms of removed documents may be left with empty postings, they are not saved
+        vector<uint32_t> saved_terms;
+        for (uint32_t term_id = 0; term_id < term_postings_.size(); ++term_id) {
+            if (!term_postings_[term_id].Empty()) {
+                saved_terms.push_back(term_id);
+            }
+        }
+        sort(saved_terms.begin(), saved_terms.end(), [this](uint32_t lhs, uint32_t rhs) {
+            return terms_.GetTerm(lhs) < terms_.GetTerm(rhs);
+        });
+
+        vector<int32_t> document_ids;
+        vector<int32_t> document_ratings;
+        vector<int32_t> document_statuses;
+        for (const int document_id : document_ids_) {
+            const int ordinal = GetOrdinal(document_id);
+            document_ids.push_back(document_id);
+            document_ratings.push_back(ordinal_ratings_[ordinal]);
+            document_statuses.push_back(static_cast<int32_t>(ordinal_statuses_[ordinal]));
+        }
+
+        // The file keeps postings by document id, ordinals follow the order of adding
+        string strings;
+        vector<IndexFileTerm> terms;
+        vector<int32_t> posting_ids;
+        vector<double> posting_freqs;
+        vector<pair<int32_t, double>> postings;
+        for (const uint32_t term_id : saved_terms) {
+            const string_view term = terms_.GetTerm(term_id);
+            IndexFileTerm entry = {{strings.size(), term.size()}, posting_ids.size(), term_postings_[term_id].Size(), 0.0, ComputeTermInverseDocumentFreq(term_id)};
+            strings.append(term);
+            postings.clear();
+            term_postings_[term_id].ForEach([this, &postings](int ordinal, double term_freq) {
+                postings.push_back({ordinal_ids_[ordinal], term_freq});
+            });
+            sort(postings.begin(), postings.end());
+            for (const auto& [document_id, term_freq] : postings) {
+                posting_ids.push_back(document_id);
+                posting_freqs.push_back(term_freq);
+                entry.max_term_freq = max(entry.max_term_freq, term_freq);
+            }
+            terms.push_back(entry);
+        }
+        vector<IndexFileString> stop_words;
+        for (const string& word : stop_words_) {
+            stop_words.push_back({strings.size(), word.size()});
+            strings.append(word);
+        }
+
+        IndexFileHeader header = {};
+        header.magic = INDEX_FILE_MAGIC;
+        header.version = INDEX_FILE_VERSION;
+        header.document_count = document_ids.size();
+        header.term_count = terms.size();
+        header.stop_word_count = stop_words.size();
+        header.posting_count = posting_ids.size();
+        header.strings_size = strings.size();
+
+        struct Section {
+            uint64_t& offset;
+            const void* data;
+            uint64_t size;
+        };
+        const vector<Section> sections = {
+            {header.document_ids_offset, document_ids.data(), document_ids.size() * sizeof(int32_t)},
+            {header.document_ratings_offset, document_ratings.data(), document_ratings.size() * sizeof(int32_t)},
+            {header.document_statuses_offset, document_statuses.data(), document_statuses.size() * sizeof(int32_t)},
+            {header.terms_offset, terms.data(), terms.size() * sizeof(IndexFileTerm)},
+            {header.stop_words_offset, stop_words.data(), stop_words.size() * sizeof(IndexFileString)},
+            {header.posting_ids_offset, posting_ids.data(), posting_ids.size() * sizeof(int32_t)},
+            {header.posting_freqs_offset, posting_freqs.data(), posting_freqs.size() * sizeof(double)},
+            {header.strings_offset, strings.data(), strings.size()},
+        };
+        uint64_t file_size = sizeof(IndexFileHeader);
+        for (const Section& section : sections) {
+            section.offset = AlignIndexFileOffset(file_size);
+            file_size = section.offset + section.size;
+        }
+        header.file_size = file_size;
+
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t position = sizeof(IndexFileHeader);
+        for (const Section& section : sections) {
+            static const char padding[8] = {};
+            out.write(padding, section.offset - position);
+            out.write(static_cast<const char*>(section.data), section.size);
+            position = section.offset + section.size;
+        }
+        out.close();
+        if (!out) {
+            throw runtime_error("Can't write index file "s + path);
+        }
     }
 
 tuple<SearchServer::MatchWords, DocumentStatus> SearchServer::MatchDocument(const string_view raw_query, int document_id) const {
@@ -71,18 +469,17 @@ tuple<SearchServer::MatchWords, DocumentStatus> SearchServer::MatchDocument(cons
 }
 
 tuple<SearchServer::MatchWords, DocumentStatus> SearchServer::MatchDocument(execution::sequenced_policy policy, const string_view raw_query, int document_id) const {
-        if (!documents_.count(document_id)) {
+        const auto it = id_to_ordinal_.find(document_id);
+        if (it == id_to_ordinal_.end()) {
             throw out_of_range("Defunct document_id"s);
         }
+        const int ordinal = it->second;
     
         auto query = ParseQuery(raw_query, true);
         
         bool found_minus_word = false; 
-        for (const string_view word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            if (word_to_document_freqs_.at((string)word).count(document_id)) {
+        for (const uint32_t term_id : query.minus_terms) {
+            if (term_postings_[term_id].Contains(ordinal)) {
                 found_minus_word = true;
                 break;
             }
@@ -90,73 +487,136 @@ tuple<SearchServer::MatchWords, DocumentStatus> SearchServer::MatchDocument(exec
     
         vector<string_view> matched_words;
         if (!found_minus_word) {
-            for (const string_view word : query.plus_words) {
-                if (word_to_document_freqs_.count(word) == 0) {
-                    continue;
-                }
-                if (word_to_document_freqs_.at((string)word).count(document_id)) {
-                    matched_words.push_back(word);
+            for (const uint32_t term_id : query.plus_terms) {
+                if (term_postings_[term_id].Contains(ordinal)) {
+                    matched_words.push_back(terms_.GetTerm(term_id));
                 }
             }
         }
         
-        return {matched_words, documents_.at(document_id).status};
+        return {matched_words, ordinal_statuses_[ordinal]};
     }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::parallel_policy policy, const string_view raw_query, int document_id) const {
-    if (!documents_.count(document_id)) {
+    const auto it = id_to_ordinal_.find(document_id);
+    if (it == id_to_ordinal_.end()) {
         throw out_of_range("Defunct document_id"s);
     }
+    const int ordinal = it->second;
     
     auto query = ParseQuery(raw_query, false);
     
-    bool found_minus_word = any_of(policy, query.minus_words.begin(), query.minus_words.end(), [this, &document_id](const string_view word){
-        if (word_to_document_freqs_.count(word)) {
-            return (bool)word_to_document_freqs_.at((string)word).count(document_id);
-        }
-        return false;
+    // Every term is probed as a task on the pool, the flags are gathered afterwards in order
+    vector<char> minus_found(query.minus_terms.size());
+    ForEachIndex(policy, GetExecutor(), query.minus_terms.size(), [this, ordinal, &query, &minus_found](size_t index){
+        minus_found[index] = term_postings_[query.minus_terms[index]].Contains(ordinal);
     });
+    bool found_minus_word = find(minus_found.begin(), minus_found.end(), 1) != minus_found.end();
     
     vector<string_view> matched_words;
     
     if (!found_minus_word) {
-        matched_words.resize(query.plus_words.size());
-        auto new_end = copy_if (policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [this, &document_id](const string_view word){
-            if (word_to_document_freqs_.count(word)) {
-                return (bool)word_to_document_freqs_.at((string)word).count(document_id);   
-            }
-            return false;
+        vector<char> plus_found(query.plus_terms.size());
+        ForEachIndex(policy, GetExecutor(), query.plus_terms.size(), [this, ordinal, &query, &plus_found](size_t index){
+            plus_found[index] = term_postings_[query.plus_terms[index]].Contains(ordinal);
         });
-        matched_words.resize(new_end - matched_words.begin());
-        sort(policy, matched_words.begin(), matched_words.end());
-        matched_words.erase(unique(policy, matched_words.begin(), matched_words.end()), matched_words.end());
+        vector<uint32_t> matched_terms;
+        for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+            if (plus_found[i]) {
+                matched_terms.push_back(query.plus_terms[i]);
+            }
+        }
+        sort(matched_terms.begin(), matched_terms.end());
+        matched_terms.erase(unique(matched_terms.begin(), matched_terms.end()), matched_terms.end());
+        matched_words.reserve(matched_terms.size());
+        for (const uint32_t term_id : matched_terms) {
+            matched_words.push_back(terms_.GetTerm(term_id));
+        }
+        sort(matched_words.begin(), matched_words.end());
     }
     
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, ordinal_statuses_[ordinal]};
 }
 
-bool SearchServer::IsStopWord(const string_view word) const {
-        return stop_words_.count((string)word) > 0;
+future<tuple<SearchServer::MatchWords, DocumentStatus>> SearchServer::MatchDocumentAsync(string raw_query, int document_id) const {
+        auto result = make_shared<promise<tuple<MatchWords, DocumentStatus>>>();
+        auto future = result->get_future();
+        GetExecutor().Submit([this, result, raw_query = move(raw_query), document_id]() {
+            try {
+                result->set_value(MatchDocument(execution::seq, raw_query, document_id));
+            } catch (...) {
+                result->set_exception(current_exception());
+            }
+        });
+        return future;
     }
 
-bool SearchServer::IsValidWord(const string_view word) {
-        // A valid word must not contain special characters
-        return none_of(word.begin(), word.end(), [](char c) {
-            return c >= '\0' && c < ' ';
-        });
+void SearchServer::FindTermDocuments(uint32_t term_id, const vector<int>& ordinals, const vector<size_t>& ordinal_order, vector<size_t>& positions) const {
+        const PostingList& postings = term_postings_[term_id];
+        if (const DocumentBitmap* bitmap = postings.GetBitmap()) {
+            for (const size_t position : ordinal_order) {
+                if (bitmap->Contains(ordinals[position])) {
+                    positions.push_back(position);
+                }
+            }
+            return;
+        }
+        // One merge of the postings with the requested ordinals, skipping blocks between them
+        auto cursor = postings.GetCursor();
+        for (const size_t position : ordinal_order) {
+            cursor.SkipTo(ordinals[position]);
+            if (cursor.IsEnd()) {
+                break;
+            }
+            if (cursor.DocumentId() == ordinals[position]) {
+                positions.push_back(position);
+            }
+        }
     }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(const string_view text) const {
-        vector<string_view> words;
-        for (const string_view word : SplitIntoWords(text)) {
-            if (!IsValidWord(word)) {
-                throw invalid_argument("Word "s + (string)word + " is invalid"s);
+void SearchServer::CollectDocumentMatches(const Query& query, const vector<vector<size_t>>& term_positions, DocumentMatches& matches) const {
+        const size_t document_count = matches.document_ids.size();
+        vector<char> has_minus_word(document_count, 0);
+        for (size_t index = query.plus_terms.size(); index < term_positions.size(); ++index) {
+            for (const size_t position : term_positions[index]) {
+                has_minus_word[position] = 1;
             }
-            if (!IsStopWord(word)) {
-                words.push_back(word);
+        }
+
+        // Counts become offsets, then plus terms in word order fill every document's span in word order
+        vector<size_t> term_counts(document_count, 0);
+        for (size_t index = 0; index < query.plus_terms.size(); ++index) {
+            for (const size_t position : term_positions[index]) {
+                term_counts[position] += has_minus_word[position] ? 0 : 1;
             }
         }
-        return words;
+        matches.term_offsets.assign(document_count + 1, 0);
+        for (size_t position = 0; position < document_count; ++position) {
+            matches.term_offsets[position + 1] = matches.term_offsets[position] + term_counts[position];
+        }
+        matches.term_ids.resize(matches.term_offsets.back());
+        vector<size_t> next_slots(matches.term_offsets.begin(), matches.term_offsets.end() - 1);
+        for (size_t index = 0; index < query.plus_terms.size(); ++index) {
+            for (const size_t position : term_positions[index]) {
+                if (!has_minus_word[position]) {
+                    matches.term_ids[next_slots[position]++] = query.plus_terms[index];
+                }
+            }
+        }
+    }
+
+bool SearchServer::IsStopWord(const string_view word) const {
+        return stop_words_.count(word) > 0;
+    }
+
+void SearchServer::SplitIntoWordsNoStop(const string_view text, vector<string_view>& words) const {
+        const size_t invalid_word = SplitIntoWords(text, words);
+        if (invalid_word != words.size()) {
+            throw invalid_argument("Word "s + (string)words[invalid_word] + " is invalid"s);
+        }
+        words.erase(remove_if(words.begin(), words.end(), [this](const string_view word) {
+            return IsStopWord(word);
+        }), words.end());
     }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
@@ -167,44 +627,44 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
         return rating_sum / static_cast<int>(ratings.size());
     }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view text) const {
-        if (all_of(text.begin(), text.end(), [](char c){ return c == ' '; })) {
-            throw invalid_argument("Query word is empty"s);
-        }
-        string_view word = text;
-        bool is_minus = false;
-        if (word[0] == '-') {
-            is_minus = true;
-            word = word.substr(1);
-        }
-        if (all_of(word.begin(), word.end(), [](char c){ return c == ' '; }) || word[0] == '-' || !IsValidWord(word)) {
-            throw invalid_argument("Query word "s + (string)text + " is invalid");
-        }
-
-        return {word, is_minus, IsStopWord(word)};
+SearchServer::Query SearchServer::ParseQuery(const string_view text, bool need_sort) const {
+        QueryContext context;
+        ParseQuery(text, need_sort, context);
+        return move(context.query_);
     }
 
-SearchServer::Query SearchServer::ParseQuery(const string_view text, bool need_sort) const {
-        SearchServer::Query result;
-        for (const string_view word : SplitIntoWords(text)) {
-            const auto query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
-                if (query_word.is_minus) {
-                    result.minus_words.push_back(query_word.data);
-                } else {
-                    result.plus_words.push_back(query_word.data);
-                }
+void SearchServer::ParseQuery(const string_view text, bool need_sort, QueryContext& context) const {
+        ParseQueryWords(text, need_sort, [this](const string_view word) {
+            return IsStopWord(word);
+        }, context.words_, context.query_words_);
+
+        const CorpusStatistics* corpus_statistics = context.corpus_statistics_ ? context.corpus_statistics_ : corpus_statistics_.get();
+        Query& result = context.query_;
+        result.plus_terms.clear();
+        result.plus_term_idfs.clear();
+        result.minus_terms.clear();
+        for (const string_view word : context.query_words_.plus_words) {
+            const uint32_t term_id = terms_.Find(word);
+            if (term_id != TermDictionary::NO_TERM) {
+                result.plus_terms.push_back(term_id);
+                result.plus_term_idfs.push_back(term_postings_[term_id].Empty() ? 0.0 : ComputeTermInverseDocumentFreq(term_id, corpus_statistics));
             }
         }
-        if (need_sort) {
-            sort(result.plus_words.begin(), result.plus_words.end());
-            result.plus_words.erase(unique(result.plus_words.begin(), result.plus_words.end()), result.plus_words.end());
-            sort(result.minus_words.begin(), result.minus_words.end());
-            result.minus_words.erase(unique(result.minus_words.begin(), result.minus_words.end()), result.minus_words.end());
+        for (const string_view word : context.query_words_.minus_words) {
+            const uint32_t term_id = terms_.Find(word);
+            if (term_id != TermDictionary::NO_TERM) {
+                result.minus_terms.push_back(term_id);
+            }
         }
-        return result;
     }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view word) const {
-        return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at((string)word).size());
+double SearchServer::ComputeTermInverseDocumentFreq(uint32_t term_id) const {
+        return ComputeTermInverseDocumentFreq(term_id, corpus_statistics_.get());
+    }
+
+double SearchServer::ComputeTermInverseDocumentFreq(uint32_t term_id, const CorpusStatistics* corpus_statistics) const {
+        if (corpus_statistics) {
+            return log(corpus_statistics->GetDocumentCount() * 1.0 / corpus_statistics->GetDocumentFreq(terms_.GetTerm(term_id)));
+        }
+        return log(GetDocumentCount() * 1.0 / term_postings_[term_id].Size());
     }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <tuple>
 #include <algorithm>
 #include <numeric>
@@ -12,25 +13,59 @@
 #include <cmath>
 #include <stdexcept>
 #include <type_traits>
+#include <thread>
+#include <climits>
+#include <memory>
+#include <cstdint>
+#include <exception>
+#include <utility>
+#include <future>
 #include "document.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
-
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
+#include "posting_list.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
+#include "max_score.h"
+#include "document_bitmap.h"
+#include "corpus_statistics.h"
+#include "index_file.h"
+#include "thread_pool.h"
+#include "query_control.h"
 
 class SearchServer {
 public:
+    static const size_t DEFAULT_RESULT_DOCUMENT_COUNT = 5;
     
     std::set<int>::const_iterator begin() const;
     
     std::set<int>::const_iterator end() const;
     
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    struct TermFrequency {
+        uint32_t term_id;
+        double freq;
+    };
+
+    // Terms of the document ordered by term id
+    const std::vector<TermFrequency>& GetTermFrequencies(int document_id) const;
+
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    std::string_view GetTerm(uint32_t term_id) const;
+
+    const std::set<std::string, std::less<>>& GetStopWords() const;
     
     void RemoveDocument(int document_id);
     
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy policy, int document_id);
+
+    // Removes the documents at once: their postings are grouped by term and every touched list
+    // is rewritten in one pass, lists run as parallel tasks under the policy. Unknown and
+    // repeated ids are ignored. Lists left without postings release their memory
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    template <typename ExecutionPolicy>
+    void RemoveDocuments(ExecutionPolicy policy, const std::vector<int>& document_ids);
     
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words);
@@ -41,24 +76,156 @@ public:
     
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    struct NewDocument {
+        int id;
+        std::string_view text;
+        DocumentStatus status;
+        std::vector<int> ratings;
+    };
+
+    // Bulk ingest of a range of NewDocument: documents are tokenized in parallel under the policy,
+    // then postings of every term are built in one sorted pass. Indexes the same as adding the
+    // documents one by one in range order. Throws std::invalid_argument before changing anything
+    // if an id is invalid, repeated or present, or a document has an invalid word
+    template <typename ExecutionPolicy, typename DocumentRange>
+    void AddDocuments(ExecutionPolicy policy, const DocumentRange& documents);
+
+    template <typename DocumentRange>
+    void AddDocuments(const DocumentRange& documents);
+
+    // The two halves of AddDocuments. Tokenizing reads only the stop words, so it may run
+    // concurrently with writes to the server, e.g. for the next batch of a pipeline.
+    // Words point into the document texts, which must outlive AddTokenizedDocuments
+    struct TokenizedDocument {
+        int id = 0;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        int rating = 0;
+        // Sorted by word
+        std::vector<std::pair<std::string_view, double>> word_freqs;
+    };
+
+    template <typename ExecutionPolicy, typename DocumentRange>
+    std::vector<TokenizedDocument> TokenizeDocuments(ExecutionPolicy policy, const DocumentRange& documents) const ;
+
+    template <typename ExecutionPolicy>
+    void AddTokenizedDocuments(ExecutionPolicy policy, const std::vector<TokenizedDocument>& documents);
+
+    // Adds a document that is already tokenized, e.g. when copying it from another index.
+    // Words are taken as is, rating is the final average rating
+    void AddIndexedDocument(int document_id, const std::map<std::string_view, double>& word_freqs, DocumentStatus status, int rating);
+
+    // top_k bounds the number of returned documents, best first
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const ;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
     
     template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const ;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
 
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const ;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
     
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status) const ;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
     
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const ;
     
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const ;
 
+    // Buffers of a query that the next queries reuse, so steady-state sequential queries
+    // make no heap allocations. Not thread-safe, keep one per thread
+    class QueryContext;
+
+    // Sequential FindTopDocuments into the context, the results are valid until its next query
+    template <typename DocumentPredicate>
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, const std::string_view raw_query, DocumentStatus status, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, const std::string_view raw_query) const ;
+
+    // Position in the ranked results of a query that FindTopDocumentsPage continues from:
+    // the ranking key of the last document of a page. The default cursor is the start
+    class PageCursor {
+    public:
+        PageCursor()
+            : has_last_(false)
+        {
+        }
+
+        bool IsStart() const {
+            return !has_last_;
+        }
+
+    private:
+        friend class SearchServer;
+
+        Document last_;
+        bool has_last_;
+    };
+
+    struct ResultPage {
+        std::vector<Document> documents;
+        // Continues after this page, meaningful while has_more
+        PageCursor next;
+        bool has_more = false;
+    };
+
+    // The page_size documents ranked right after the cursor in IsBetterDocument order. Only documents
+    // after the cursor enter a top-k of page_size + 1, so a deep page costs about as much as the first
+    // and the whole match set is never sorted. Changes to the index between pages may skip or repeat documents
+    template <typename ExecutionPolicy>
+    ResultPage FindTopDocumentsPage(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t page_size, const PageCursor& cursor = PageCursor()) const ;
+
+    ResultPage FindTopDocumentsPage(const std::string_view raw_query, DocumentStatus status, size_t page_size, const PageCursor& cursor = PageCursor()) const ;
+
+    // Sequential FindTopDocuments that stops when control says so, see SearchResult.
+    // A query stopped before it starts returns no documents
+    SearchResult FindTopDocuments(const QueryControl& control, const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    // Runs the query above as a task on the executor, so queries of concurrent requests run side by side.
+    // control may be null. The server must outlive the future and not change until it is ready
+    std::future<SearchResult> FindTopDocumentsAsync(std::string raw_query, std::shared_ptr<const QueryControl> control = nullptr, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    // Answers every query like FindTopDocuments(policy, query, status, top_k), result i for query i.
+    // All queries are parsed first, every distinct word of the batch is looked up and gets its IDF once,
+    // then each query is scored as a separate task. Throws the error of the first invalid query
+    template <typename ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(ExecutionPolicy policy, const std::vector<std::string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    // The results of the batch concatenated in query order, written in place into one preallocated vector
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsBatchJoined(ExecutionPolicy policy, const std::vector<std::string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
     int GetDocumentCount() const ;
 
+    // Both throw std::out_of_range for unknown documents
+    int GetDocumentRating(int document_id) const ;
+
+    DocumentStatus GetDocumentStatus(int document_id) const ;
+
+    bool HasDocument(int document_id) const ;
+
+    // Grows on every change of the index or of its corpus statistics: any such change
+    // moves IDF, so results computed under another generation may be stale
+    uint64_t GetGeneration() const ;
+
+    // Sorted unique plus and minus words of the query without stop words, the same
+    // for queries that FindTopDocuments answers the same way. Words point into raw_query.
+    // Throws std::invalid_argument for invalid queries
+    QueryWords NormalizeQuery(const std::string_view raw_query) const ;
+
+    // Pool that runs the work of parallel policies, ThreadPool::GetDefault() unless set
+    void SetExecutor(std::shared_ptr<ThreadPool> executor);
+
+    ThreadPool& GetExecutor() const ;
+
+    // Makes IDF come from corpus-wide statistics when the server holds only a part of the corpus
+    void SetCorpusStatistics(std::shared_ptr<const CorpusStatistics> corpus_statistics);
+
+    // Writes the index to a binary file that MappedSearchServer serves without loading it.
+    // Throws std::runtime_error if the file can't be written
+    void SaveIndex(const std::string& path) const;
+
     using MatchWords = std::vector<std::string_view>;
 
     std::tuple<MatchWords, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const ;
@@ -67,69 +234,231 @@ public:
     
     std::tuple<MatchWords, DocumentStatus> MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query, int document_id) const ;
 
-private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    // MatchDocument as a task on the executor, the future holds std::out_of_range for unknown documents
+    std::future<std::tuple<MatchWords, DocumentStatus>> MatchDocumentAsync(std::string raw_query, int document_id) const ;
+
+    // Results of MatchDocuments in request order, matched terms of all documents in one array:
+    // terms of document i are term_ids[term_offsets[i]] up to term_ids[term_offsets[i + 1]],
+    // ordered by word like MatchDocument, GetTerm gives the words
+    struct DocumentMatches {
+        std::vector<int> document_ids;
+        std::vector<DocumentStatus> statuses;
+        std::vector<uint32_t> term_ids;
+        std::vector<size_t> term_offsets;
     };
+
+    // MatchDocument for every id of the range with the query parsed once. Every query term walks
+    // its postings once against the requested documents, terms run as parallel tasks under the policy.
+    // Throws std::out_of_range for unknown documents
+    template <typename ExecutionPolicy, typename DocumentIdRange>
+    DocumentMatches MatchDocuments(ExecutionPolicy policy, const std::string_view raw_query, const DocumentIdRange& document_ids) const ;
+
+    template <typename DocumentIdRange>
+    DocumentMatches MatchDocuments(const std::string_view raw_query, const DocumentIdRange& document_ids) const ;
+
+private:
+    const std::set<std::string, std::less<>> stop_words_;
     
-    const std::set<std::string> stop_words_;
-    
-    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
-    
-    std::map<int, std::map<std::string_view, double>> id_to_word_freqs_;
-    
-    std::map<int, DocumentData> documents_;
-    
+    TermDictionary terms_;
+
+    // Indexed by term id, postings hold document ordinals
+    std::vector<PostingList> term_postings_;
+
+    // Documents get dense ordinals in the order they are added, so the hot loop of a query
+    // reads their data from arrays. A removed document leaves a hole (NO_DOCUMENT id)
+    // until holes outnumber the documents and CompactOrdinals renumbers them
+    static constexpr int NO_DOCUMENT = -1;
+    std::vector<int> ordinal_ids_;
+    std::vector<int> ordinal_ratings_;
+    std::vector<DocumentStatus> ordinal_statuses_;
+    std::vector<std::vector<TermFrequency>> ordinal_term_freqs_;
+    size_t removed_ordinal_count_ = 0;
+
+    std::unordered_map<int, int> id_to_ordinal_;
+
+    // Ordinals of the documents of every status, queries by status skip the others before scoring
+    static const size_t STATUS_COUNT = 4;
+    DocumentBitmap status_bitmaps_[STATUS_COUNT];
+
     std::set<int> document_ids_;
 
-    static bool IsValidWord(const std::string_view word);
-    
+    std::shared_ptr<const CorpusStatistics> corpus_statistics_;
+
+    uint64_t generation_ = 0;
+
+    std::shared_ptr<ThreadPool> executor_;
+
     bool IsStopWord(const std::string_view word) const ;
     
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const ;
+    // Throws std::invalid_argument for invalid words
+    void SplitIntoWordsNoStop(const std::string_view text, std::vector<std::string_view>& words) const ;
 
     static int ComputeAverageRating(const std::vector<int>& ratings) ;
 
-    struct QueryWord {
-        std::string_view data;
-        bool is_minus;
-        bool is_stop;
+    void IndexDocument(int document_id, const std::map<uint32_t, double>& term_freqs, DocumentStatus status, int rating);
+
+    // Returns the ordinal of the new document, postings are not touched
+    int AddDocumentData(int document_id, DocumentStatus status, int rating, std::vector<TermFrequency> term_freqs);
+
+    // Throws std::out_of_range for unknown documents
+    int GetOrdinal(int document_id) const ;
+
+    // Renumbers the documents without holes, keeping their order
+    void CompactOrdinals();
+
+    const DocumentBitmap& GetStatusBitmap(DocumentStatus status) const ;
+
+    TokenizedDocument TokenizeDocument(const NewDocument& document) const ;
+
+    struct TermPostingsUpdate {
+        uint32_t term_id;
+        std::vector<int> ordinals;
+        std::vector<double> term_freqs;
     };
 
-    QueryWord ParseQueryWord(const std::string_view text) const ;
+    struct TermRemovals {
+        uint32_t term_id;
+        std::vector<int> ordinals;
+    };
+
+    // Drops the documents from everything but postings, returns their postings grouped by term
+    std::vector<TermRemovals> UnindexDocuments(const std::vector<int>& document_ids);
+
+    void ValidateNewDocumentIds(const std::vector<TokenizedDocument>& documents) const ;
 
+    // Interns the words and adds everything but postings, returns new postings of every touched term
+    std::vector<TermPostingsUpdate> IndexTokenizedDocuments(const std::vector<TokenizedDocument>& documents);
+
+    // Words missing from the dictionary are dropped, they can't match any document
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<uint32_t> plus_terms;
+        // IDF of every plus term, 0 for terms without documents
+        std::vector<double> plus_term_idfs;
+        std::vector<uint32_t> minus_terms;
     };
 
     Query ParseQuery(const std::string_view text, bool need_sort) const ;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const ;
+    // Parses into context.query_
+    void ParseQuery(const std::string_view text, bool need_sort, QueryContext& context) const ;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(Query& query, DocumentPredicate document_predicate) const ;
+    // Non-empty postings required
+    double ComputeTermInverseDocumentFreq(uint32_t term_id) const ;
 
-    template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy policy, Query& query, DocumentPredicate document_predicate) const ;
+    // IDF from corpus_statistics if it is set, from the server itself otherwise
+    double ComputeTermInverseDocumentFreq(uint32_t term_id, const CorpusStatistics* corpus_statistics) const ;
+
+    // Positions in ordinals (visited in ascending ordinal order) of the documents that have the term
+    void FindTermDocuments(uint32_t term_id, const std::vector<int>& ordinals, const std::vector<size_t>& ordinal_order, std::vector<size_t>& positions) const ;
+
+    // Fills the terms of matches.document_ids from the positions found for every term of the query
+    void CollectDocumentMatches(const Query& query, const std::vector<std::vector<size_t>>& term_positions, DocumentMatches& matches) const ;
+
+    // Calls write_results(index, documents) for every query of the batch, concurrently under the policy
+    template <typename ExecutionPolicy, typename ResultWriter>
+    void FindBatch(ExecutionPolicy policy, const std::vector<std::string>& raw_queries, DocumentStatus status, size_t top_k, ResultWriter write_results) const ;
+
+    // FindTopDocuments over the ordinals in document_mask only
+    template <typename DocumentMask, typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindMaskedDocuments(ExecutionPolicy policy, const std::string_view raw_query, const DocumentMask& document_mask, DocumentPredicate document_predicate, size_t top_k) const ;
+
+    template <typename DocumentMask, typename DocumentPredicate>
+    const std::vector<Document>& FindMaskedDocuments(QueryContext& context, const std::string_view raw_query, const DocumentMask& document_mask, DocumentPredicate document_predicate, size_t top_k) const ;
+
+    // Scores only documents with ordinals in [first_ordinal, last_ordinal] into context.top_documents_,
+    // only the ones ranked after after if it is set. Returns false if should_stop ended the scoring early
+    template <typename DocumentMask, typename DocumentPredicate, typename StopCondition = NeverStop>
+    bool FindDocumentsInRange(const Query& query, const DocumentMask& document_mask, DocumentPredicate document_predicate, size_t top_k, int first_ordinal, int last_ordinal, QueryContext& context,
+                              const Document* after = nullptr, StopCondition should_stop = StopCondition()) const ;
+};
+
+class SearchServer::QueryContext {
+public:
+    // Queries through the context take IDF from these statistics instead of those of the server.
+    // The statistics must outlive the queries
+    void SetCorpusStatistics(const CorpusStatistics* corpus_statistics) {
+        corpus_statistics_ = corpus_statistics;
+    }
+
+private:
+    friend class SearchServer;
+
+    std::vector<std::string_view> words_;
+    QueryWords query_words_;
+    Query query_;
+    std::vector<ScoredCursor<PostingList::Cursor>> plus_cursors_;
+    std::vector<PostingList::Cursor> minus_cursors_;
+    std::vector<const DocumentBitmap*> minus_bitmaps_;
+    MaxScoreWorkspace workspace_;
+    TopDocumentsCollector top_documents_{0};
+    std::vector<Document> results_;
+    const CorpusStatistics* corpus_statistics_ = nullptr;
 };
 
 template <typename ExecutionPolicy>
     void SearchServer::RemoveDocument(ExecutionPolicy policy, int document_id){
-        std::vector<std::string_view> words;
-        words.reserve(id_to_word_freqs_.size());
-        for_each(policy, id_to_word_freqs_[document_id].begin(), id_to_word_freqs_[document_id].end(), [&words](const auto& elem){
-            words.push_back(elem.first);
+        RemoveDocuments(policy, std::vector<int>{document_id});
+    }
+
+template <typename ExecutionPolicy>
+    void SearchServer::RemoveDocuments(ExecutionPolicy policy, const std::vector<int>& document_ids) {
+        // Every task owns one posting list, so the lists need no locks
+        const auto removals = UnindexDocuments(document_ids);
+        ForEachIndex(policy, GetExecutor(), removals.size(), [this, &removals](size_t index) {
+            PostingList& postings = term_postings_[removals[index].term_id];
+            postings.RemovePostings(removals[index].ordinals);
+            if (postings.Empty()) {
+                postings = PostingList();
+            }
+        });
+        if (removed_ordinal_count_ > document_ids_.size()) {
+            CompactOrdinals();
+        }
+    }
+
+template <typename ExecutionPolicy, typename DocumentRange>
+    void SearchServer::AddDocuments(ExecutionPolicy policy, const DocumentRange& documents) {
+        AddTokenizedDocuments(policy, TokenizeDocuments(policy, documents));
+    }
+
+template <typename ExecutionPolicy, typename DocumentRange>
+    std::vector<SearchServer::TokenizedDocument> SearchServer::TokenizeDocuments(ExecutionPolicy policy, const DocumentRange& documents) const {
+        std::vector<const NewDocument*> batch;
+        for (const NewDocument& document : documents) {
+            batch.push_back(&document);
+        }
+
+        // Errors are kept by index, so the one rethrown afterwards is the first in order, not the first to happen
+        std::vector<TokenizedDocument> tokenized_documents(batch.size());
+        std::vector<std::exception_ptr> errors(batch.size());
+        ForEachIndex(policy, GetExecutor(), batch.size(), [&](size_t index) {
+            try {
+                tokenized_documents[index] = TokenizeDocument(*batch[index]);
+            } catch (...) {
+                errors[index] = std::current_exception();
+            }
         });
-        for_each(policy, words.begin(), words.end(), [this, &document_id](const std::string_view word){
-            word_to_document_freqs_[(std::string)word].erase(document_id);
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        return tokenized_documents;
+    }
+
+template <typename ExecutionPolicy>
+    void SearchServer::AddTokenizedDocuments(ExecutionPolicy policy, const std::vector<TokenizedDocument>& documents) {
+        ValidateNewDocumentIds(documents);
+        auto updates = IndexTokenizedDocuments(documents);
+        ForEachIndex(policy, GetExecutor(), updates.size(), [this, &updates](size_t index) {
+            const TermPostingsUpdate& update = updates[index];
+            term_postings_[update.term_id].AddPostings(update.ordinals, update.term_freqs);
         });
-        id_to_word_freqs_.erase(document_id);
-        documents_.erase(document_id);
-        auto iter = find(policy, document_ids_.begin(), document_ids_.end(), document_id);
-        document_ids_.erase(iter);
+    }
+
+template <typename DocumentRange>
+    void SearchServer::AddDocuments(const DocumentRange& documents) {
+        AddDocuments(std::execution::seq, documents);
     }
 
 template <typename StringContainer>
@@ -142,35 +471,53 @@ template <typename StringContainer>
     }
 
 template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
-        auto query = ParseQuery(raw_query, true);
+    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindMaskedDocuments(policy, raw_query, AllDocuments(), document_predicate, top_k);
+    }
 
-        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template <typename DocumentPredicate>
+    const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindMaskedDocuments(context, raw_query, AllDocuments(), document_predicate, top_k);
+    }
 
-        std::sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < std::numeric_limits<double>::epsilon()) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
+template <typename DocumentMask, typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> SearchServer::FindMaskedDocuments(ExecutionPolicy policy, const std::string_view raw_query, const DocumentMask& document_mask, DocumentPredicate document_predicate, size_t top_k) const {
+        QueryContext context;
+        if constexpr (IsParallelPolicy<ExecutionPolicy>()) {
+            ParseQuery(raw_query, true, context);
+            if (document_ids_.empty()) {
+                return {};
             }
-        });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+            const Query& query = context.query_;
+            return EvaluateInIdChunks(policy, GetExecutor(), 0, static_cast<int>(ordinal_ids_.size()) - 1, top_k, [&](int first_ordinal, int last_ordinal) {
+                QueryContext chunk_context;
+                FindDocumentsInRange(query, document_mask, document_predicate, top_k, first_ordinal, last_ordinal, chunk_context);
+                return std::move(chunk_context.top_documents_);
+            });
+        } else {
+            FindMaskedDocuments(context, raw_query, document_mask, document_predicate, top_k);
+            return std::move(context.results_);
         }
+    }
 
-        return matched_documents; 
+template <typename DocumentMask, typename DocumentPredicate>
+    const std::vector<Document>& SearchServer::FindMaskedDocuments(QueryContext& context, const std::string_view raw_query, const DocumentMask& document_mask, DocumentPredicate document_predicate, size_t top_k) const {
+        ParseQuery(raw_query, true, context);
+        FindDocumentsInRange(context.query_, document_mask, document_predicate, top_k, 0, INT_MAX, context);
+        context.top_documents_.ExtractTo(context.results_);
+        return context.results_;
     }
 
 template <typename DocumentPredicate>
-    std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-        return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
     }
 
 template <typename ExecutionPolicy>
-    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+    std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+        return FindMaskedDocuments(policy, raw_query, GetStatusBitmap(status), [](int document_id, DocumentStatus document_status, int rating) {
+            return true;
+        }, top_k);
     }
 
 template <typename ExecutionPolicy>
@@ -178,74 +525,210 @@ template <typename ExecutionPolicy>
         return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
     }
 
-template <typename DocumentPredicate>
-    std::vector<Document> SearchServer::FindAllDocuments(SearchServer::Query& query, DocumentPredicate document_predicate) const {
-        std::map<int, double> document_to_relevance;
+template <typename ExecutionPolicy>
+    std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(ExecutionPolicy policy, const std::vector<std::string>& raw_queries, DocumentStatus status, size_t top_k) const {
+        std::vector<std::vector<Document>> results(raw_queries.size());
+        FindBatch(policy, raw_queries, status, top_k, [&results](size_t index, const std::vector<Document>& documents) {
+            results[index] = documents;
+        });
+        return results;
+    }
 
-        for (const std::string_view word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at((std::string)word)) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
-                }
+template <typename ExecutionPolicy>
+    std::vector<Document> SearchServer::FindTopDocumentsBatchJoined(ExecutionPolicy policy, const std::vector<std::string>& raw_queries, DocumentStatus status, size_t top_k) const {
+        // Every query writes into its own slot, then the gaps after short results are closed
+        const size_t slot_size = std::min(top_k, document_ids_.size());
+        std::vector<Document> results(raw_queries.size() * slot_size);
+        std::vector<size_t> result_counts(raw_queries.size());
+        FindBatch(policy, raw_queries, status, top_k, [&](size_t index, const std::vector<Document>& documents) {
+            std::copy(documents.begin(), documents.end(), results.begin() + index * slot_size);
+            result_counts[index] = documents.size();
+        });
+        size_t size = 0;
+        for (size_t index = 0; index < raw_queries.size(); ++index) {
+            const auto slot = results.begin() + index * slot_size;
+            if (size != index * slot_size) {
+                std::copy(slot, slot + result_counts[index], results.begin() + size);
             }
+            size += result_counts[index];
         }
+        results.resize(size);
+        return results;
+    }
 
-        for (const std::string_view word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            for (const auto [document_id, _] : word_to_document_freqs_.at((std::string)word)) {
-                document_to_relevance.erase(document_id);
+template <typename ExecutionPolicy>
+    SearchServer::ResultPage SearchServer::FindTopDocumentsPage(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t page_size, const PageCursor& cursor) const {
+        // One document past the page tells whether there is a next one. A page larger than the index
+        // can't have a next one, the clamp keeps the extra slot from overflowing
+        const size_t top_k = std::min(page_size, document_ids_.size()) + 1;
+        const Document* after = cursor.has_last_ ? &cursor.last_ : nullptr;
+        const DocumentBitmap& status_bitmap = GetStatusBitmap(status);
+        const auto accept_all = [](int document_id, DocumentStatus document_status, int rating) {
+            return true;
+        };
+        QueryContext context;
+        ParseQuery(raw_query, true, context);
+        ResultPage page;
+        if constexpr (IsParallelPolicy<ExecutionPolicy>()) {
+            if (!document_ids_.empty()) {
+                page.documents = EvaluateInIdChunks(policy, GetExecutor(), 0, static_cast<int>(ordinal_ids_.size()) - 1, top_k, [&](int first_ordinal, int last_ordinal) {
+                    QueryContext chunk_context;
+                    FindDocumentsInRange(context.query_, status_bitmap, accept_all, top_k, first_ordinal, last_ordinal, chunk_context, after);
+                    return std::move(chunk_context.top_documents_);
+                });
             }
+        } else {
+            FindDocumentsInRange(context.query_, status_bitmap, accept_all, top_k, 0, INT_MAX, context, after);
+            page.documents = context.top_documents_.Extract();
         }
+        if (page.documents.size() > page_size) {
+            page.documents.resize(page_size);
+            page.has_more = page_size > 0;
+        }
+        if (!page.documents.empty()) {
+            page.next.last_ = page.documents.back();
+            page.next.has_last_ = true;
+        }
+        return page;
+    }
 
-        std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance) {
-            matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+template <typename ExecutionPolicy, typename DocumentIdRange>
+    SearchServer::DocumentMatches SearchServer::MatchDocuments(ExecutionPolicy policy, const std::string_view raw_query, const DocumentIdRange& document_ids) const {
+        DocumentMatches matches;
+        std::vector<int> ordinals;
+        for (const int document_id : document_ids) {
+            const auto it = id_to_ordinal_.find(document_id);
+            if (it == id_to_ordinal_.end()) {
+                throw std::out_of_range("Defunct document_id");
+            }
+            matches.document_ids.push_back(document_id);
+            matches.statuses.push_back(ordinal_statuses_[it->second]);
+            ordinals.push_back(it->second);
         }
-        return matched_documents;
+        const Query query = ParseQuery(raw_query, true);
+
+        std::vector<size_t> ordinal_order(ordinals.size());
+        std::iota(ordinal_order.begin(), ordinal_order.end(), 0);
+        std::sort(ordinal_order.begin(), ordinal_order.end(), [&ordinals](size_t lhs, size_t rhs) {
+            return ordinals[lhs] < ordinals[rhs];
+        });
+        // Plus terms first, then minus terms
+        std::vector<std::vector<size_t>> term_positions(query.plus_terms.size() + query.minus_terms.size());
+        ForEachIndex(policy, GetExecutor(), term_positions.size(), [&](size_t index) {
+            const uint32_t term_id = index < query.plus_terms.size() ? query.plus_terms[index] : query.minus_terms[index - query.plus_terms.size()];
+            FindTermDocuments(term_id, ordinals, ordinal_order, term_positions[index]);
+        });
+        CollectDocumentMatches(query, term_positions, matches);
+        return matches;
     }
 
-    template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, SearchServer::Query& query, DocumentPredicate document_predicate) const {
-        if (std::is_same_v<ExecutionPolicy, std::execution::parallel_policy>) {
-            ConcurrentMap<int, double> document_to_relevance_par(100);
-
-            for_each(policy, query.plus_words.begin(), query.plus_words.end(), [&](const auto& word){
-                if (word_to_document_freqs_.count(word)) {
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    const auto& document_freqs_ = word_to_document_freqs_.at((std::string)word);
-                    for_each(policy, document_freqs_.begin(), document_freqs_.end(), [&](const auto& id_and_freq){
-                        const auto& document_data = documents_.at(id_and_freq.first);
-                        if (document_predicate(id_and_freq.first, document_data.status, document_data.rating)) {
-                            document_to_relevance_par[id_and_freq.first].ref_to_value += id_and_freq.second * inverse_document_freq;
-                        }
-                    });
-                }
-            });
+template <typename DocumentIdRange>
+    SearchServer::DocumentMatches SearchServer::MatchDocuments(const std::string_view raw_query, const DocumentIdRange& document_ids) const {
+        return MatchDocuments(std::execution::seq, raw_query, document_ids);
+    }
+
+template <typename ExecutionPolicy, typename ResultWriter>
+    void SearchServer::FindBatch(ExecutionPolicy policy, const std::vector<std::string>& raw_queries, DocumentStatus status, size_t top_k, ResultWriter write_results) const {
+        // Errors are kept by index, so the one rethrown afterwards is the first in order, not the first to happen
+        std::vector<QueryWords> query_words(raw_queries.size());
+        std::vector<std::exception_ptr> errors(raw_queries.size());
+        ForEachIndex(policy, GetExecutor(), raw_queries.size(), [&](size_t index) {
+            try {
+                query_words[index] = NormalizeQuery(raw_queries[index]);
+            } catch (...) {
+                errors[index] = std::current_exception();
+            }
+        });
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
 
-            for (const std::string_view word : query.minus_words) {
-                if (word_to_document_freqs_.count(word) == 0) {
-                    continue;
+        std::vector<std::string_view> batch_words;
+        for (const QueryWords& words : query_words) {
+            batch_words.insert(batch_words.end(), words.plus_words.begin(), words.plus_words.end());
+            batch_words.insert(batch_words.end(), words.minus_words.begin(), words.minus_words.end());
+        }
+        std::sort(batch_words.begin(), batch_words.end());
+        batch_words.erase(std::unique(batch_words.begin(), batch_words.end()), batch_words.end());
+        std::vector<uint32_t> batch_terms(batch_words.size());
+        std::vector<double> batch_term_idfs(batch_words.size(), 0.0);
+        for (size_t i = 0; i < batch_words.size(); ++i) {
+            batch_terms[i] = terms_.Find(batch_words[i]);
+            if (batch_terms[i] != TermDictionary::NO_TERM && !term_postings_[batch_terms[i]].Empty()) {
+                batch_term_idfs[i] = ComputeTermInverseDocumentFreq(batch_terms[i]);
+            }
+        }
+        const auto find_batch_word = [&batch_words](const std::string_view word) {
+            return static_cast<size_t>(std::lower_bound(batch_words.begin(), batch_words.end(), word) - batch_words.begin());
+        };
+
+        const DocumentBitmap& status_bitmap = GetStatusBitmap(status);
+        // Queries are claimed one at a time, so a slow one holds up nobody else. Every thread reuses
+        // the buffers of its own context, the calling thread has the slot after the workers
+        ThreadPool& executor = GetExecutor();
+        std::vector<QueryContext> contexts(IsParallelPolicy<ExecutionPolicy>() ? executor.GetThreadCount() + 1 : 1);
+        ForEachIndex(policy, executor, raw_queries.size(), [&](size_t index) {
+            QueryContext& context = contexts[IsParallelPolicy<ExecutionPolicy>() ? executor.GetCurrentWorker() : 0];
+            Query& query = context.query_;
+            query.plus_terms.clear();
+            query.plus_term_idfs.clear();
+            query.minus_terms.clear();
+            for (const std::string_view word : query_words[index].plus_words) {
+                const size_t batch_word = find_batch_word(word);
+                if (batch_terms[batch_word] != TermDictionary::NO_TERM) {
+                    query.plus_terms.push_back(batch_terms[batch_word]);
+                    query.plus_term_idfs.push_back(batch_term_idfs[batch_word]);
                 }
-                for (const auto [document_id, _] : word_to_document_freqs_.at((std::string)word)) {
-                    document_to_relevance_par.Erase(document_id);
+            }
+            for (const std::string_view word : query_words[index].minus_words) {
+                const size_t batch_word = find_batch_word(word);
+                if (batch_terms[batch_word] != TermDictionary::NO_TERM) {
+                    query.minus_terms.push_back(batch_terms[batch_word]);
                 }
             }
+            FindDocumentsInRange(query, status_bitmap, [](int document_id, DocumentStatus document_status, int rating) {
+                return true;
+            }, top_k, 0, INT_MAX, context);
+            context.top_documents_.ExtractTo(context.results_);
+            write_results(index, context.results_);
+        });
+    }
 
-            auto document_to_relevance = document_to_relevance_par.BuildOrdinaryMap();
-            
-            std::vector<Document> matched_documents;
-            for (const auto [document_id, relevance] : document_to_relevance) {
-                matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+template <typename DocumentMask, typename DocumentPredicate, typename StopCondition>
+    bool SearchServer::FindDocumentsInRange(const SearchServer::Query& query, const DocumentMask& document_mask, DocumentPredicate document_predicate, size_t top_k, int first_ordinal, int last_ordinal, QueryContext& context,
+                                            const Document* after, StopCondition should_stop) const {
+        auto& plus_cursors = context.plus_cursors_;
+        plus_cursors.clear();
+        for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+            const auto& postings = term_postings_[query.plus_terms[i]];
+            if (postings.Empty()) {
+                continue;
+            }
+            const double inverse_document_freq = query.plus_term_idfs[i];
+            plus_cursors.push_back({postings.GetCursor(), inverse_document_freq, postings.MaxTermFreq() * inverse_document_freq});
+        }
+
+        // Dense minus-words exclude their documents through the mask before scoring,
+        // sparse ones are cheaper to probe for the few candidates that can enter the top
+        auto& minus_cursors = context.minus_cursors_;
+        auto& minus_bitmaps = context.minus_bitmaps_;
+        minus_cursors.clear();
+        minus_bitmaps.clear();
+        for (const uint32_t term_id : query.minus_terms) {
+            const auto& postings = term_postings_[term_id];
+            if (const DocumentBitmap* bitmap = postings.GetBitmap()) {
+                minus_bitmaps.push_back(bitmap);
+            } else {
+                minus_cursors.push_back(postings.GetCursor());
             }
-            return matched_documents;
-        } else {
-            return FindAllDocuments(query, document_predicate);
         }
-    }
\ No newline at end of file
+
+        context.top_documents_.Reset(top_k, after);
+        return EvaluateMaxScore(plus_cursors, minus_cursors, ExcludingMask<DocumentMask>{document_mask, minus_bitmaps}, [this, &document_predicate](int ordinal, Document& document) {
+            document.id = ordinal_ids_[ordinal];
+            document.rating = ordinal_ratings_[ordinal];
+            return document_predicate(document.id, ordinal_statuses_[ordinal], document.rating);
+        }, first_ordinal, last_ordinal, context.workspace_, context.top_documents_, should_stop);
+    }
@@ -0,0 +1,282 @@
+#include "segmented_search_server.h"
+#include <algorithm>
+
+using namespace std;
+
+using namespace std::string_literals;
+
+size_t SegmentedSearchServer::Segment::FindPosition(int document_id) const {
+        const auto it = lower_bound(document_ids.begin(), document_ids.end(), document_id);
+        if (it == document_ids.end() || *it != document_id) {
+            return document_ids.size();
+        }
+        return it - document_ids.begin();
+    }
+
+bool SegmentedSearchServer::Segment::IsLive(int document_id) const {
+        const size_t position = FindPosition(document_id);
+        return position != document_ids.size() && !IsDeleted(position);
+    }
+
+SegmentedSearchServer::SegmentedSearchServer(const string_view stop_words_text, size_t segment_capacity, size_t merge_factor)
+        : SegmentedSearchServer(SplitIntoWords(stop_words_text), segment_capacity, merge_factor)
+    {
+    }
+
+SegmentedSearchServer::SegmentedSearchServer(const string stop_words_text, size_t segment_capacity, size_t merge_factor)
+        : SegmentedSearchServer(SplitIntoWords((string_view)stop_words_text), segment_capacity, merge_factor)
+    {
+    }
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+        {
+            lock_guard guard(merge_mutex_);
+            stopping_ = true;
+        }
+        merge_cv_.notify_all();
+        merger_.join();
+    }
+
+set<int>::const_iterator SegmentedSearchServer::begin() const {
+    return document_ids_.begin();
+}
+
+set<int>::const_iterator SegmentedSearchServer::end() const {
+    return document_ids_.end();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
+        bool is_frozen = false;
+        {
+            unique_lock lock(mutex_);
+            if ((document_id < 0) || (document_ids_.count(document_id) > 0)) {
+                throw invalid_argument("Invalid document_id"s);
+            }
+            active_->AddDocument(document_id, document, status, ratings);
+            corpus_statistics_->AddDocument(GetDocumentWords(*active_, document_id));
+            document_ids_.insert(document_id);
+            if (static_cast<size_t>(active_->GetDocumentCount()) >= segment_capacity_) {
+                FreezeActiveSegment();
+                is_frozen = true;
+            }
+        }
+        if (is_frozen) {
+            RequestMerge();
+        }
+    }
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+        unique_lock lock(mutex_);
+        if (document_ids_.count(document_id) == 0) {
+            return;
+        }
+        document_ids_.erase(document_id);
+        for (const auto& segment : segments_) {
+            const size_t position = segment->FindPosition(document_id);
+            if (position != segment->document_ids.size() && !segment->IsDeleted(position)) {
+                segment->MarkDeleted(position);
+                --segment->live_count;
+                corpus_statistics_->RemoveDocument(GetDocumentWords(*segment->index, document_id));
+                return;
+            }
+        }
+        corpus_statistics_->RemoveDocument(GetDocumentWords(*active_, document_id));
+        active_->RemoveDocument(document_id);
+    }
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(execution::seq, raw_query, status, top_k);
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(const string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<SearchServer::MatchWords, DocumentStatus> SegmentedSearchServer::MatchDocument(const string_view raw_query, int document_id) const {
+        shared_lock lock(mutex_);
+        if (document_ids_.count(document_id) == 0) {
+            throw out_of_range("Defunct document_id"s);
+        }
+        const SearchServer* index = active_.get();
+        for (const auto& segment : segments_) {
+            if (segment->IsLive(document_id)) {
+                index = segment->index.get();
+                break;
+            }
+        }
+        auto [words, status] = index->MatchDocument(raw_query, document_id);
+        // A merge may free the segment's dictionary, the statistics keep every word forever
+        for (string_view& word : words) {
+            word = corpus_statistics_->FindWord(word);
+        }
+        return {words, status};
+    }
+
+int SegmentedSearchServer::GetDocumentCount() const {
+        shared_lock lock(mutex_);
+        return static_cast<int>(document_ids_.size());
+    }
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+        shared_lock lock(mutex_);
+        return segments_.size();
+    }
+
+void SegmentedSearchServer::Flush() {
+        {
+            unique_lock lock(mutex_);
+            FreezeActiveSegment();
+        }
+        RequestMerge();
+        unique_lock guard(merge_mutex_);
+        merge_cv_.wait(guard, [this]() {
+            return !merge_requested_ && !merge_running_;
+        });
+    }
+
+unique_ptr<SearchServer> SegmentedSearchServer::MakeIndex() const {
+        auto index = make_unique<SearchServer>(stop_words_);
+        index->SetCorpusStatistics(corpus_statistics_);
+        return index;
+    }
+
+vector<string_view> SegmentedSearchServer::GetDocumentWords(const SearchServer& index, int document_id) const {
+        vector<string_view> words;
+        for (const auto& term_freq : index.GetTermFrequencies(document_id)) {
+            words.push_back(index.GetTerm(term_freq.term_id));
+        }
+        return words;
+    }
+
+void SegmentedSearchServer::FreezeActiveSegment() {
+        if (active_->GetDocumentCount() == 0) {
+            return;
+        }
+        auto segment = make_shared<Segment>();
+        segment->document_ids.assign(active_->begin(), active_->end());
+        segment->tombstones.assign((segment->document_ids.size() + 63) / 64, 0);
+        segment->live_count = segment->document_ids.size();
+        segment->index = move(active_);
+        segments_.push_back(move(segment));
+        active_ = MakeIndex();
+    }
+
+vector<shared_ptr<SegmentedSearchServer::Segment>> SegmentedSearchServer::PickMergeInputs() {
+        // Tiered policy: tier t holds segments of [capacity * factor^t, capacity * factor^(t+1)) live documents
+        map<size_t, vector<shared_ptr<Segment>>> tiers;
+        for (const auto& segment : segments_) {
+            if (segment->is_merging) {
+                continue;
+            }
+            size_t tier = 0;
+            for (size_t bound = segment_capacity_ * merge_factor_; segment->live_count >= bound; bound *= merge_factor_) {
+                ++tier;
+            }
+            tiers[tier].push_back(segment);
+        }
+        for (auto& [tier, candidates] : tiers) {
+            if (candidates.size() >= merge_factor_) {
+                sort(candidates.begin(), candidates.end(), [](const auto& lhs, const auto& rhs) {
+                    return lhs->live_count < rhs->live_count;
+                });
+                candidates.resize(merge_factor_);
+                for (const auto& segment : candidates) {
+                    segment->is_merging = true;
+                }
+                return candidates;
+            }
+        }
+        return {};
+    }
+
+void SegmentedSearchServer::MergeSegments(const vector<shared_ptr<Segment>>& inputs) {
+        // Inputs are immutable apart from tombstones, so the new segment is built without the lock;
+        // deletes that happen meanwhile are replayed when it is installed
+        vector<pair<int, const Segment*>> sources;
+        {
+            shared_lock lock(mutex_);
+            for (const auto& segment : inputs) {
+                for (size_t position = 0; position < segment->document_ids.size(); ++position) {
+                    if (!segment->IsDeleted(position)) {
+                        sources.push_back({segment->document_ids[position], segment.get()});
+                    }
+                }
+            }
+        }
+        sort(sources.begin(), sources.end());
+
+        auto index = MakeIndex();
+        for (const auto& [document_id, source] : sources) {
+            const SearchServer& source_index = *source->index;
+            index->AddIndexedDocument(document_id, source_index.GetWordFrequencies(document_id),
+                source_index.GetDocumentStatus(document_id), source_index.GetDocumentRating(document_id));
+        }
+
+        auto merged = make_shared<Segment>();
+        merged->document_ids.reserve(sources.size());
+        for (const auto& [document_id, source] : sources) {
+            merged->document_ids.push_back(document_id);
+        }
+        merged->tombstones.assign((sources.size() + 63) / 64, 0);
+        merged->live_count = sources.size();
+        merged->index = move(index);
+
+        unique_lock lock(mutex_);
+        for (size_t position = 0; position < sources.size(); ++position) {
+            const auto [document_id, source] = sources[position];
+            if (!source->IsLive(document_id)) {
+                merged->MarkDeleted(position);
+                --merged->live_count;
+            }
+        }
+        auto it = find(segments_.begin(), segments_.end(), inputs.front());
+        *it = move(merged);
+        segments_.erase(remove_if(segments_.begin(), segments_.end(), [&inputs](const auto& segment) {
+            return find(inputs.begin(), inputs.end(), segment) != inputs.end();
+        }), segments_.end());
+    }
+
+void SegmentedSearchServer::RunMerger() {
+        unique_lock guard(merge_mutex_);
+        while (true) {
+            merge_cv_.wait(guard, [this]() {
+                return stopping_ || merge_requested_;
+            });
+            if (stopping_) {
+                return;
+            }
+            merge_requested_ = false;
+            merge_running_ = true;
+            guard.unlock();
+            while (true) {
+                vector<shared_ptr<Segment>> inputs;
+                {
+                    unique_lock lock(mutex_);
+                    inputs = PickMergeInputs();
+                }
+                if (inputs.empty()) {
+                    break;
+                }
+                MergeSegments(inputs);
+            }
+            guard.lock();
+            merge_running_ = false;
+            merge_cv_.notify_all();
+        }
+    }
+
+void SegmentedSearchServer::RequestMerge() {
+        {
+            lock_guard guard(merge_mutex_);
+            merge_requested_ = true;
+        }
+        merge_cv_.notify_all();
+    }
+
+void SegmentedSearchServer::SetExecutor(shared_ptr<ThreadPool> executor) {
+        executor_ = move(executor);
+    }
+
+ThreadPool& SegmentedSearchServer::GetExecutor() const {
+        return executor_ ? *executor_ : ThreadPool::GetDefault();
+    }
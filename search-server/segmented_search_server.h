@@ -0,0 +1,221 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <numeric>
+#include <execution>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include "document.h"
+#include "search_server.h"
+#include "corpus_statistics.h"
+#include "top_documents.h"
+#include "thread_pool.h"
+#include "string_processing.h"
+
+// Append-only LSM-style index. New documents go to a small active segment which is frozen
+// once it holds segment_capacity documents; frozen segments are never modified, deletes
+// only set bits in their tombstone bitmaps. A background thread compacts every
+// merge_factor frozen segments of a similar size into one, dropping the deleted documents.
+// Queries and matching see all segments as one index with corpus-wide IDF.
+// Like SearchServer, the public methods must not be called concurrently with writes
+class SegmentedSearchServer {
+public:
+    static const size_t DEFAULT_SEGMENT_CAPACITY = 4096;
+    static const size_t DEFAULT_MERGE_FACTOR = 4;
+
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer& stop_words, size_t segment_capacity = DEFAULT_SEGMENT_CAPACITY, size_t merge_factor = DEFAULT_MERGE_FACTOR);
+
+    explicit SegmentedSearchServer(const std::string_view stop_words_text, size_t segment_capacity = DEFAULT_SEGMENT_CAPACITY, size_t merge_factor = DEFAULT_MERGE_FACTOR);
+
+    explicit SegmentedSearchServer(const std::string stop_words_text, size_t segment_capacity = DEFAULT_SEGMENT_CAPACITY, size_t merge_factor = DEFAULT_MERGE_FACTOR);
+
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+    ~SegmentedSearchServer();
+
+    std::set<int>::const_iterator begin() const;
+
+    std::set<int>::const_iterator end() const;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const ;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const ;
+
+    // Matched words live as long as the server
+    std::tuple<SearchServer::MatchWords, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const ;
+
+    int GetDocumentCount() const ;
+
+    // Number of frozen segments, the active one excluded
+    size_t GetSegmentCount() const ;
+
+    // Freezes the active segment and blocks until no more merges are due
+    void Flush();
+
+    // Pool that runs the work of parallel policies, ThreadPool::GetDefault() unless set
+    void SetExecutor(std::shared_ptr<ThreadPool> executor);
+
+    ThreadPool& GetExecutor() const ;
+
+private:
+    struct Segment {
+        std::shared_ptr<const SearchServer> index;
+        // Sorted ids of the segment, a tombstone bit per id
+        std::vector<int> document_ids;
+        std::vector<uint64_t> tombstones;
+        size_t live_count = 0;
+        bool is_merging = false;
+
+        // Position of the id in document_ids or document_ids.size()
+        size_t FindPosition(int document_id) const;
+
+        bool IsDeleted(size_t position) const {
+            return (tombstones[position / 64] >> (position % 64)) & 1;
+        }
+
+        void MarkDeleted(size_t position) {
+            tombstones[position / 64] |= uint64_t(1) << (position % 64);
+        }
+
+        bool IsLive(int document_id) const;
+    };
+
+    const std::vector<std::string> stop_words_;
+    const size_t segment_capacity_;
+    const size_t merge_factor_;
+    const std::shared_ptr<CorpusStatistics> corpus_statistics_;
+
+    // Guards everything below: queries share it, writes and merge installs take it exclusively
+    mutable std::shared_mutex mutex_;
+    std::unique_ptr<SearchServer> active_;
+    std::vector<std::shared_ptr<Segment>> segments_;
+    std::set<int> document_ids_;
+    std::shared_ptr<ThreadPool> executor_;
+
+    std::mutex merge_mutex_;
+    std::condition_variable merge_cv_;
+    bool merge_requested_ = false;
+    bool merge_running_ = false;
+    bool stopping_ = false;
+    std::thread merger_;
+
+    std::unique_ptr<SearchServer> MakeIndex() const;
+
+    std::vector<std::string_view> GetDocumentWords(const SearchServer& index, int document_id) const;
+
+    // Requires mutex_ held exclusively
+    void FreezeActiveSegment();
+
+    // Requires mutex_ held at least shared; returns inputs marked as merging or nothing
+    std::vector<std::shared_ptr<Segment>> PickMergeInputs();
+
+    void MergeSegments(const std::vector<std::shared_ptr<Segment>>& inputs);
+
+    void RunMerger();
+
+    void RequestMerge();
+
+    // Merges the top documents of the active segment, query_segment(active_, nullptr), and of every
+    // frozen one, query_segment(index, &segment). Requires mutex_ held at least shared
+    template <typename ExecutionPolicy, typename SegmentQuery>
+    std::vector<Document> FindInSegments(ExecutionPolicy policy, size_t top_k, SegmentQuery query_segment) const ;
+};
+
+template <typename StringContainer>
+    SegmentedSearchServer::SegmentedSearchServer(const StringContainer& stop_words, size_t segment_capacity, size_t merge_factor)
+        : stop_words_([&stop_words]() {
+            const auto unique_stop_words = MakeUniqueNonEmptyStrings(stop_words);
+            return std::vector<std::string>(unique_stop_words.begin(), unique_stop_words.end());
+        }())
+        , segment_capacity_(std::max<size_t>(segment_capacity, 1))
+        , merge_factor_(std::max<size_t>(merge_factor, 2))
+        , corpus_statistics_(std::make_shared<CorpusStatistics>())
+        , active_(MakeIndex())
+        , merger_([this]() { RunMerger(); })
+    {
+    }
+
+template <typename ExecutionPolicy, typename SegmentQuery>
+    std::vector<Document> SegmentedSearchServer::FindInSegments(ExecutionPolicy policy, size_t top_k, SegmentQuery query_segment) const {
+        // Slot 0 is the active segment, it has no tombstones
+        std::vector<std::vector<Document>> segment_tops(segments_.size() + 1);
+        ForEachIndex(policy, GetExecutor(), segment_tops.size(), [&](size_t index){
+            if (index == 0) {
+                segment_tops[index] = query_segment(*active_, nullptr);
+            } else {
+                segment_tops[index] = query_segment(*segments_[index - 1]->index, segments_[index - 1].get());
+            }
+        });
+
+        TopDocumentsCollector top_documents(top_k);
+        for (const auto& segment_top : segment_tops) {
+            for (const Document& document : segment_top) {
+                top_documents.Add(document);
+            }
+        }
+        return top_documents.Extract();
+    }
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        std::shared_lock lock(mutex_);
+        return FindInSegments(policy, top_k, [&](const SearchServer& index, const Segment* segment) {
+            if (segment == nullptr) {
+                return index.FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
+            }
+            return index.FindTopDocuments(std::execution::seq, raw_query, [segment, &document_predicate](int document_id, DocumentStatus status, int rating) {
+                return segment->IsLive(document_id) && document_predicate(document_id, status, rating);
+            }, top_k);
+        });
+    }
+
+template <typename DocumentPredicate>
+    std::vector<Document> SegmentedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
+    }
+
+template <typename ExecutionPolicy>
+    std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+        std::shared_lock lock(mutex_);
+        // Segments select the status by their status bitmaps, only deleted documents need a predicate
+        return FindInSegments(policy, top_k, [&](const SearchServer& index, const Segment* segment) {
+            if (segment == nullptr || segment->live_count == segment->document_ids.size()) {
+                return index.FindTopDocuments(std::execution::seq, raw_query, status, top_k);
+            }
+            return index.FindTopDocuments(std::execution::seq, raw_query, [segment, status](int document_id, DocumentStatus document_status, int rating) {
+                return document_status == status && segment->IsLive(document_id);
+            }, top_k);
+        });
+    }
+
+template <typename ExecutionPolicy>
+    std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const {
+        return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    }
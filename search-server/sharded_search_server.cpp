@@ -0,0 +1,81 @@
+#include "sharded_search_server.h"
+
+using namespace std;
+
+using namespace std::string_literals;
+
+ShardedSearchServer::ShardedSearchServer(const string_view stop_words_text, size_t shard_count)
+        : ShardedSearchServer(SplitIntoWords(stop_words_text), shard_count)
+    {
+    }
+
+ShardedSearchServer::ShardedSearchServer(const string stop_words_text, size_t shard_count)
+        : ShardedSearchServer(SplitIntoWords((string_view)stop_words_text), shard_count)
+    {
+    }
+
+set<int>::const_iterator ShardedSearchServer::begin() const {
+    return document_ids_.begin();
+}
+
+set<int>::const_iterator ShardedSearchServer::end() const {
+    return document_ids_.end();
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
+    if (document_id < 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    SearchServer& shard = shards_[GetShardIndex(document_id)];
+    shard.AddDocument(document_id, document, status, ratings);
+    corpus_statistics_->AddDocument(GetDocumentWords(shard, document_id));
+    document_ids_.insert(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if (document_ids_.count(document_id) == 0) {
+        return;
+    }
+    SearchServer& shard = shards_[GetShardIndex(document_id)];
+    corpus_statistics_->RemoveDocument(GetDocumentWords(shard, document_id));
+    shard.RemoveDocument(document_id);
+    document_ids_.erase(document_id);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(execution::seq, raw_query, status, top_k);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<SearchServer::MatchWords, DocumentStatus> ShardedSearchServer::MatchDocument(const string_view raw_query, int document_id) const {
+    if (document_id < 0) {
+        throw out_of_range("Defunct document_id"s);
+    }
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    return static_cast<int>(document_ids_.size());
+}
+
+vector<string_view> ShardedSearchServer::GetDocumentWords(const SearchServer& shard, int document_id) const {
+    vector<string_view> words;
+    for (const auto& term_freq : shard.GetTermFrequencies(document_id)) {
+        words.push_back(shard.GetTerm(term_freq.term_id));
+    }
+    return words;
+}
+
+void ShardedSearchServer::SetExecutor(shared_ptr<ThreadPool> executor) {
+        for (SearchServer& shard : shards_) {
+            shard.SetExecutor(executor);
+        }
+        executor_ = move(executor);
+    }
+
+ThreadPool& ShardedSearchServer::GetExecutor() const {
+        return executor_ ? *executor_ : ThreadPool::GetDefault();
+    }
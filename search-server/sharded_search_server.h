@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <tuple>
+#include <memory>
+#include <numeric>
+#include <execution>
+#include <stdexcept>
+#include "document.h"
+#include "search_server.h"
+#include "corpus_statistics.h"
+#include "top_documents.h"
+#include "thread_pool.h"
+
+// Splits documents across shard_count SearchServer instances by document id.
+// Queries scatter to every shard and gather the per-shard top-k lists; IDF stays
+// corpus-wide because all shards share one CorpusStatistics
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, size_t shard_count);
+
+    ShardedSearchServer(const std::string_view stop_words_text, size_t shard_count);
+
+    ShardedSearchServer(const std::string stop_words_text, size_t shard_count);
+
+    std::set<int>::const_iterator begin() const;
+
+    std::set<int>::const_iterator end() const;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const ;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const ;
+
+    std::tuple<SearchServer::MatchWords, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const ;
+
+    int GetDocumentCount() const ;
+
+    // Pool that runs the work of parallel policies, ThreadPool::GetDefault() unless set,
+    // the shards get it too
+    void SetExecutor(std::shared_ptr<ThreadPool> executor);
+
+    ThreadPool& GetExecutor() const ;
+
+    size_t GetShardCount() const {
+        return shards_.size();
+    }
+
+    const SearchServer& GetShard(size_t shard) const {
+        return shards_[shard];
+    }
+
+private:
+    std::vector<SearchServer> shards_;
+    std::shared_ptr<CorpusStatistics> corpus_statistics_;
+    std::set<int> document_ids_;
+    std::shared_ptr<ThreadPool> executor_;
+
+    size_t GetShardIndex(int document_id) const {
+        return static_cast<size_t>(document_id) % shards_.size();
+    }
+
+    std::vector<std::string_view> GetDocumentWords(const SearchServer& shard, int document_id) const ;
+
+    // Merges query_shard(shard) of every shard into the top_k best documents
+    template <typename ExecutionPolicy, typename ShardQuery>
+    std::vector<Document> FindInShards(ExecutionPolicy policy, size_t top_k, ShardQuery query_shard) const ;
+};
+
+template <typename StringContainer>
+    ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, size_t shard_count)
+        : corpus_statistics_(std::make_shared<CorpusStatistics>())
+    {
+        if (shard_count == 0) {
+            throw std::invalid_argument("Shard count must be positive");
+        }
+        shards_.reserve(shard_count);
+        for (size_t i = 0; i < shard_count; ++i) {
+            shards_.emplace_back(stop_words);
+            shards_.back().SetCorpusStatistics(corpus_statistics_);
+        }
+    }
+
+template <typename ExecutionPolicy, typename ShardQuery>
+    std::vector<Document> ShardedSearchServer::FindInShards(ExecutionPolicy policy, size_t top_k, ShardQuery query_shard) const {
+        // Parallelism is across shards, each shard scores its part sequentially
+        std::vector<std::vector<Document>> shard_tops(shards_.size());
+        ForEachIndex(policy, GetExecutor(), shards_.size(), [&](size_t shard){
+            shard_tops[shard] = query_shard(shards_[shard]);
+        });
+
+        TopDocumentsCollector top_documents(top_k);
+        for (const auto& shard_top : shard_tops) {
+            for (const Document& document : shard_top) {
+                top_documents.Add(document);
+            }
+        }
+        return top_documents.Extract();
+    }
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindInShards(policy, top_k, [&](const SearchServer& shard) {
+            return shard.FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
+        });
+    }
+
+template <typename DocumentPredicate>
+    std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
+    }
+
+template <typename ExecutionPolicy>
+    std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+        // The shards select the status by their status bitmaps before scoring
+        return FindInShards(policy, top_k, [&](const SearchServer& shard) {
+            return shard.FindTopDocuments(std::execution::seq, raw_query, status, top_k);
+        });
+    }
+
+template <typename ExecutionPolicy>
+    std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const {
+        return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    }
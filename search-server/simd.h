@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// SSE2 code paths are compiled where SSE2 is part of the target baseline (every x86-64),
+// defining SEARCH_SERVER_NO_SIMD forces the scalar fallbacks
+#if !defined(SEARCH_SERVER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SEARCH_SERVER_HAS_SSE2
+#endif
+
+// Index of the lowest set bit, mask must not be zero
+inline uint32_t CountTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+inline uint32_t CountTrailingZeros(uint64_t mask) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<uint32_t>(index);
+#elif defined(_MSC_VER)
+    const uint32_t low = static_cast<uint32_t>(mask);
+    return low != 0 ? CountTrailingZeros(low) : 32 + CountTrailingZeros(static_cast<uint32_t>(mask >> 32));
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(mask));
+#endif
+}
@@ -0,0 +1,243 @@
+#include "snapshot_search_server.h"
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+using namespace std::string_literals;
+
+bool SnapshotSearchServer::Version::IsRemoved(int document_id) const {
+        return binary_search(tombstones.begin(), tombstones.end(), document_id);
+    }
+
+SnapshotSearchServer::Snapshot::Snapshot(Snapshot&& other)
+        : readers_(other.readers_)
+        , version_(other.version_)
+    {
+        other.readers_ = nullptr;
+    }
+
+SnapshotSearchServer::Snapshot::~Snapshot() {
+        if (readers_) {
+            readers_->fetch_sub(1);
+        }
+    }
+
+vector<Document> SnapshotSearchServer::Snapshot::FindTopDocuments(const string_view raw_query, DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(execution::seq, raw_query, status, top_k);
+}
+
+vector<Document> SnapshotSearchServer::Snapshot::FindTopDocuments(const string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<SearchServer::MatchWords, DocumentStatus> SnapshotSearchServer::Snapshot::MatchDocument(const string_view raw_query, int document_id) const {
+        if (version_->delta->HasDocument(document_id)) {
+            return version_->delta->MatchDocument(raw_query, document_id);
+        }
+        if (version_->IsRemoved(document_id)) {
+            throw out_of_range("Defunct document_id"s);
+        }
+        return version_->base->MatchDocument(raw_query, document_id);
+    }
+
+int SnapshotSearchServer::Snapshot::GetDocumentCount() const {
+        return version_->statistics->GetDocumentCount();
+    }
+
+SnapshotSearchServer::SnapshotSearchServer(const SearchServer& search_server, size_t merge_threshold)
+        : merge_threshold_(max<size_t>(merge_threshold, 1))
+    {
+        auto version = make_unique<Version>();
+        version->base = make_shared<SearchServer>(search_server);
+        version->delta = make_shared<SearchServer>(search_server.GetStopWords());
+        version->statistics = make_shared<CorpusStatistics>(MakeStatistics(*version->base));
+        current_.store(version.release());
+        merger_ = thread([this]() { RunMerger(); });
+    }
+
+SnapshotSearchServer::~SnapshotSearchServer() {
+        {
+            lock_guard guard(merge_mutex_);
+            stopping_ = true;
+        }
+        merge_cv_.notify_all();
+        merger_.join();
+        delete current_.load();
+    }
+
+SnapshotSearchServer::Snapshot SnapshotSearchServer::GetSnapshot() const {
+        const uint64_t epoch = epoch_.load();
+        auto& readers = readers_[epoch & 1];
+        readers.fetch_add(1);
+        // Install replaces the version before it drains the counters, so the version loaded after
+        // registering can't be freed while we stay registered, whichever counter we are in
+        return Snapshot(&readers, current_.load());
+    }
+
+int SnapshotSearchServer::GetDocumentCount() const {
+        return GetSnapshot().GetDocumentCount();
+    }
+
+void SnapshotSearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
+        lock_guard guard(write_mutex_);
+        Version& pending = GetPending();
+        if (pending.base->HasDocument(document_id) && !pending.IsRemoved(document_id)) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        pending.delta->AddDocument(document_id, document, status, ratings);
+        pending.statistics->AddDocument(GetDocumentWords(*pending.delta, document_id));
+    }
+
+void SnapshotSearchServer::RemoveDocument(int document_id) {
+        lock_guard guard(write_mutex_);
+        Version& pending = GetPending();
+        if (pending.delta->HasDocument(document_id)) {
+            pending.statistics->RemoveDocument(GetDocumentWords(*pending.delta, document_id));
+            pending.delta->RemoveDocument(document_id);
+        } else if (pending.base->HasDocument(document_id) && !pending.IsRemoved(document_id)) {
+            pending.statistics->RemoveDocument(GetDocumentWords(*pending.base, document_id));
+            pending.tombstones.insert(upper_bound(pending.tombstones.begin(), pending.tombstones.end(), document_id), document_id);
+        }
+    }
+
+void SnapshotSearchServer::Publish() {
+        bool is_merge_due = false;
+        {
+            lock_guard guard(write_mutex_);
+            if (!pending_) {
+                return;
+            }
+            is_merge_due = pending_->delta->GetDocumentCount() + pending_->tombstones.size() >= merge_threshold_;
+            Install(move(pending_));
+        }
+        if (is_merge_due) {
+            {
+                lock_guard guard(merge_mutex_);
+                merge_requested_ = true;
+            }
+            merge_cv_.notify_all();
+        }
+    }
+
+SnapshotSearchServer::Version& SnapshotSearchServer::GetPending() {
+        if (!pending_) {
+            // The base stays shared, only the parts that are about the size of the delta are copied
+            const Version& current = *current_.load();
+            pending_ = make_unique<Version>();
+            pending_->base = current.base;
+            pending_->tombstones = current.tombstones;
+            pending_->delta = make_shared<SearchServer>(*current.delta);
+            pending_->statistics = make_shared<CorpusStatistics>(*current.statistics);
+        }
+        return *pending_;
+    }
+
+void SnapshotSearchServer::Install(unique_ptr<Version> version) {
+        const Version* retired = current_.exchange(version.release());
+        // Readers that registered before the exchange may hold the retired version. A reader that read
+        // an old epoch may sit in either counter, so both are drained, each while new readers use the other
+        for (int flip = 0; flip < 2; ++flip) {
+            const uint64_t epoch = epoch_.fetch_add(1);
+            while (readers_[epoch & 1].load() != 0) {
+                this_thread::yield();
+            }
+        }
+        delete retired;
+    }
+
+unique_ptr<SnapshotSearchServer::Version> SnapshotSearchServer::Rebase(const Version& version, const Version& merged, shared_ptr<const SearchServer> merged_base,
+                                                                         shared_ptr<const CorpusStatistics> merged_statistics) const {
+        // A document of the merged delta that is still in the delta unchanged now lives in the base,
+        // one that was removed or replaced since is removed from the base
+        const auto is_merged = [&version, &merged](int document_id) {
+            return merged.delta->HasDocument(document_id) && version.delta->HasDocument(document_id)
+                && merged.delta->GetWordFrequencies(document_id) == version.delta->GetWordFrequencies(document_id)
+                && merged.delta->GetDocumentStatus(document_id) == version.delta->GetDocumentStatus(document_id)
+                && merged.delta->GetDocumentRating(document_id) == version.delta->GetDocumentRating(document_id);
+        };
+
+        auto rebased = make_unique<Version>();
+        rebased->base = move(merged_base);
+        set_difference(version.tombstones.begin(), version.tombstones.end(), merged.tombstones.begin(), merged.tombstones.end(),
+                       back_inserter(rebased->tombstones));
+        for (const int document_id : *merged.delta) {
+            if (!is_merged(document_id)) {
+                rebased->tombstones.push_back(document_id);
+            }
+        }
+        sort(rebased->tombstones.begin(), rebased->tombstones.end());
+
+        rebased->delta = make_shared<SearchServer>(version.delta->GetStopWords());
+        for (const int document_id : *version.delta) {
+            if (!is_merged(document_id)) {
+                rebased->delta->AddIndexedDocument(document_id, version.delta->GetWordFrequencies(document_id),
+                    version.delta->GetDocumentStatus(document_id), version.delta->GetDocumentRating(document_id));
+            }
+        }
+
+        rebased->statistics = make_shared<CorpusStatistics>(move(merged_statistics));
+        for (const int document_id : *rebased->delta) {
+            rebased->statistics->AddDocument(GetDocumentWords(*rebased->delta, document_id));
+        }
+        for (const int document_id : rebased->tombstones) {
+            rebased->statistics->RemoveDocument(GetDocumentWords(*rebased->base, document_id));
+        }
+        return rebased;
+    }
+
+vector<string_view> SnapshotSearchServer::GetDocumentWords(const SearchServer& index, int document_id) {
+        vector<string_view> words;
+        for (const auto& term_freq : index.GetTermFrequencies(document_id)) {
+            words.push_back(index.GetTerm(term_freq.term_id));
+        }
+        return words;
+    }
+
+shared_ptr<const CorpusStatistics> SnapshotSearchServer::MakeStatistics(const SearchServer& index) {
+        auto statistics = make_shared<CorpusStatistics>();
+        for (const int document_id : index) {
+            statistics->AddDocument(GetDocumentWords(index, document_id));
+        }
+        return statistics;
+    }
+
+void SnapshotSearchServer::MergeDelta() {
+        // Published versions are never changed, and none is freed while the write mutex is held
+        Version merged;
+        {
+            lock_guard guard(write_mutex_);
+            merged = *current_.load();
+        }
+
+        // Readers and writers go on meanwhile, writes made since are replayed over the new base by Rebase
+        auto base = make_shared<SearchServer>(*merged.base);
+        base->RemoveDocuments(merged.tombstones);
+        for (const int document_id : *merged.delta) {
+            base->AddIndexedDocument(document_id, merged.delta->GetWordFrequencies(document_id),
+                merged.delta->GetDocumentStatus(document_id), merged.delta->GetDocumentRating(document_id));
+        }
+        const auto statistics = MakeStatistics(*base);
+
+        lock_guard guard(write_mutex_);
+        Install(Rebase(*current_.load(), merged, base, statistics));
+        if (pending_) {
+            pending_ = Rebase(*pending_, merged, base, statistics);
+        }
+    }
+
+void SnapshotSearchServer::RunMerger() {
+        unique_lock guard(merge_mutex_);
+        while (true) {
+            merge_cv_.wait(guard, [this]() {
+                return stopping_ || merge_requested_;
+            });
+            if (stopping_) {
+                return;
+            }
+            merge_requested_ = false;
+            guard.unlock();
+            MergeDelta();
+            guard.lock();
+        }
+    }
@@ -0,0 +1,214 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <execution>
+#include <cstdint>
+#include "document.h"
+#include "search_server.h"
+#include "corpus_statistics.h"
+#include "top_documents.h"
+#include "thread_pool.h"
+
+// Lets queries run concurrently with AddDocument/RemoveDocument.
+// A version of the index is a large immutable base shared by many versions, the sorted ids
+// of base documents removed since and a small delta index with the documents added since.
+// Readers pin the published version and never wait for writers: taking a snapshot is
+// a fixed number of atomic operations. Writers change a private copy of the delta,
+// the tombstones and the statistics, which costs about the size of the delta, and make it
+// visible with Publish(). Once the delta and the tombstones hold merge_threshold documents
+// a background thread folds them into a new base, the copy of the base happens there.
+// A replaced version is freed once every reader that could still see it has left
+// (readers register in the counter of the current epoch parity, a publisher drains both)
+class SnapshotSearchServer {
+    struct Version;
+
+public:
+    static const size_t DEFAULT_MERGE_THRESHOLD = 4096;
+
+    // RAII pin of one version, cheap to take and keep for a few calls
+    class Snapshot {
+    public:
+        Snapshot(Snapshot&& other);
+
+        Snapshot(const Snapshot&) = delete;
+
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        Snapshot& operator=(Snapshot&&) = delete;
+
+        ~Snapshot();
+
+        template <typename DocumentPredicate, typename ExecutionPolicy>
+        std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+        template <typename DocumentPredicate>
+        std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+        template <typename ExecutionPolicy>
+        std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+        std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t top_k = SearchServer::DEFAULT_RESULT_DOCUMENT_COUNT) const ;
+
+        template <typename ExecutionPolicy>
+        std::vector<Document> FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const ;
+
+        std::vector<Document> FindTopDocuments(const std::string_view raw_query) const ;
+
+        // Matched words stay valid while the snapshot lives.
+        // Throws std::out_of_range for unknown documents
+        std::tuple<SearchServer::MatchWords, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const ;
+
+        int GetDocumentCount() const ;
+
+    private:
+        friend class SnapshotSearchServer;
+
+        Snapshot(std::atomic<int64_t>* readers, const Version* version)
+            : readers_(readers)
+            , version_(version) {
+        }
+
+        std::atomic<int64_t>* readers_;
+        const Version* version_;
+
+        // Runs query_layer(layer, context, is_base) on the base and the delta, both under the
+        // statistics of the version, and merges their top documents
+        template <typename ExecutionPolicy, typename LayerQuery>
+        std::vector<Document> FindInLayers(ExecutionPolicy policy, size_t top_k, LayerQuery query_layer) const ;
+    };
+
+    explicit SnapshotSearchServer(const SearchServer& search_server, size_t merge_threshold = DEFAULT_MERGE_THRESHOLD);
+
+    SnapshotSearchServer(const SnapshotSearchServer&) = delete;
+
+    SnapshotSearchServer& operator=(const SnapshotSearchServer&) = delete;
+
+    ~SnapshotSearchServer();
+
+    Snapshot GetSnapshot() const;
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const ;
+
+    int GetDocumentCount() const ;
+
+    // Writes go to the pending version and become visible to readers on Publish().
+    // Throws std::invalid_argument for invalid or present ids and invalid words
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    void Publish();
+
+private:
+    struct Version {
+        std::shared_ptr<const SearchServer> base;
+        // Sorted ids of the base documents removed since the base was built
+        std::vector<int> tombstones;
+        std::shared_ptr<SearchServer> delta;
+        // Corpus-wide document frequencies, so the layers score like one index
+        std::shared_ptr<CorpusStatistics> statistics;
+
+        bool IsRemoved(int document_id) const;
+    };
+
+    const size_t merge_threshold_;
+
+    std::atomic<const Version*> current_;
+    mutable std::atomic<uint64_t> epoch_ = 0;
+    mutable std::atomic<int64_t> readers_[2] = {0, 0};
+
+    // Guards the pending version and the replacement of the current one
+    std::mutex write_mutex_;
+    std::unique_ptr<Version> pending_;
+
+    std::mutex merge_mutex_;
+    std::condition_variable merge_cv_;
+    bool merge_requested_ = false;
+    bool stopping_ = false;
+    std::thread merger_;
+
+    // Requires write_mutex_
+    Version& GetPending();
+
+    // Requires write_mutex_; waits until no reader can hold the replaced version and frees it
+    void Install(std::unique_ptr<Version> version);
+
+    // The version rebuilt over merged_base, which holds the documents of merged
+    std::unique_ptr<Version> Rebase(const Version& version, const Version& merged, std::shared_ptr<const SearchServer> merged_base,
+                                    std::shared_ptr<const CorpusStatistics> merged_statistics) const;
+
+    static std::vector<std::string_view> GetDocumentWords(const SearchServer& index, int document_id);
+
+    // Document frequencies of every document of the index
+    static std::shared_ptr<const CorpusStatistics> MakeStatistics(const SearchServer& index);
+
+    void MergeDelta();
+
+    void RunMerger();
+};
+
+template <typename ExecutionPolicy, typename LayerQuery>
+    std::vector<Document> SnapshotSearchServer::Snapshot::FindInLayers(ExecutionPolicy policy, size_t top_k, LayerQuery query_layer) const {
+        std::vector<Document> layer_tops[2];
+        ForEachIndex(policy, version_->base->GetExecutor(), 2, [&](size_t layer) {
+            SearchServer::QueryContext context;
+            context.SetCorpusStatistics(version_->statistics.get());
+            layer_tops[layer] = query_layer(layer == 0 ? *version_->base : *version_->delta, context, layer == 0);
+        });
+
+        TopDocumentsCollector top_documents(top_k);
+        for (const auto& layer_top : layer_tops) {
+            for (const Document& document : layer_top) {
+                top_documents.Add(document);
+            }
+        }
+        return top_documents.Extract();
+    }
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> SnapshotSearchServer::Snapshot::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindInLayers(policy, top_k, [&](const SearchServer& layer, SearchServer::QueryContext& context, bool is_base) {
+            if (is_base && !version_->tombstones.empty()) {
+                return layer.FindTopDocuments(context, raw_query, [this, &document_predicate](int document_id, DocumentStatus status, int rating) {
+                    return !version_->IsRemoved(document_id) && document_predicate(document_id, status, rating);
+                }, top_k);
+            }
+            return layer.FindTopDocuments(context, raw_query, document_predicate, top_k);
+        });
+    }
+
+template <typename DocumentPredicate>
+    std::vector<Document> SnapshotSearchServer::Snapshot::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t top_k) const {
+        return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
+    }
+
+template <typename ExecutionPolicy>
+    std::vector<Document> SnapshotSearchServer::Snapshot::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status, size_t top_k) const {
+        return FindInLayers(policy, top_k, [&](const SearchServer& layer, SearchServer::QueryContext& context, bool is_base) {
+            // Only removed base documents need a predicate, the status is selected by the layer itself
+            if (is_base && !version_->tombstones.empty()) {
+                return layer.FindTopDocuments(context, raw_query, [this, status](int document_id, DocumentStatus document_status, int rating) {
+                    return document_status == status && !version_->IsRemoved(document_id);
+                }, top_k);
+            }
+            return layer.FindTopDocuments(context, raw_query, status, top_k);
+        });
+    }
+
+template <typename ExecutionPolicy>
+    std::vector<Document> SnapshotSearchServer::Snapshot::FindTopDocuments(ExecutionPolicy policy, const std::string_view raw_query) const {
+        return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    }
+
+template <typename... Args>
+    std::vector<Document> SnapshotSearchServer::FindTopDocuments(Args&&... args) const {
+        const auto snapshot = GetSnapshot();
+        return snapshot.FindTopDocuments(std::forward<Args>(args)...);
+    }
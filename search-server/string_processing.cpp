@@ -1,15 +1,102 @@
 #include "string_processing.h"
 
+#include <stdexcept>
+#include <cstdint>
+#include "simd.h"
+#ifdef SEARCH_SERVER_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
+using namespace std::string_literals;
+
 vector<string_view> SplitIntoWords(const string_view text) {
     vector<string_view> result;
-    int64_t pos = text.find_first_not_of(' ');
-    const int64_t pos_end = text.npos;
-    while (pos != pos_end) {
-        int64_t space = text.find(' ', pos);
-        result.push_back(space == pos_end ? text.substr(pos) : text.substr(pos, space - pos));
-        pos = text.find_first_not_of(' ', space);
-    }
+    SplitIntoWords(text, result);
     return result;
+}
+
+size_t SplitIntoWords(const string_view text, vector<string_view>& words) {
+    words.clear();
+    const char* data = text.data();
+    const size_t size = text.size();
+    const size_t no_position = text.npos;
+    size_t word_begin = no_position;
+    size_t first_invalid = no_position;
+    size_t position = 0;
+#ifdef SEARCH_SERVER_HAS_SSE2
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    for (; position + 16 <= size; position += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+        const uint32_t word_mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, spaces))) & 0xFFFF;
+        // Control characters are the bytes in [0, ' '), the comparisons are signed
+        const uint32_t invalid_mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmplt_epi8(chunk, spaces), _mm_cmpgt_epi8(chunk, minus_one)));
+        if (invalid_mask != 0 && first_invalid == no_position) {
+            first_invalid = position + CountTrailingZeros(invalid_mask);
+        }
+        // Bits where a word starts or ends, the bit before the chunk is the current state
+        uint32_t boundaries = (word_mask ^ ((word_mask << 1) | (word_begin != no_position ? 1 : 0))) & 0xFFFF;
+        while (boundaries != 0) {
+            const size_t boundary = position + CountTrailingZeros(boundaries);
+            if (word_begin == no_position) {
+                word_begin = boundary;
+            } else {
+                words.emplace_back(data + word_begin, boundary - word_begin);
+                word_begin = no_position;
+            }
+            boundaries &= boundaries - 1;
+        }
+    }
+#endif
+    for (; position < size; ++position) {
+        const char c = data[position];
+        if (c == ' ') {
+            if (word_begin != no_position) {
+                words.emplace_back(data + word_begin, position - word_begin);
+                word_begin = no_position;
+            }
+            continue;
+        }
+        if (word_begin == no_position) {
+            word_begin = position;
+        }
+        if (c >= '\0' && c < ' ' && first_invalid == no_position) {
+            first_invalid = position;
+        }
+    }
+    if (word_begin != no_position) {
+        words.emplace_back(data + word_begin, size - word_begin);
+    }
+
+    if (first_invalid == no_position) {
+        return words.size();
+    }
+    const auto invalid_word = upper_bound(words.begin(), words.end(), data + first_invalid, [](const char* invalid, const string_view word) {
+        return invalid < word.data();
+    });
+    return invalid_word - words.begin() - 1;
+}
+
+bool IsValidWord(const string_view word) {
+    return none_of(word.begin(), word.end(), [](char c) {
+        return c >= '\0' && c < ' ';
+    });
+}
+
+QueryWord ParseQueryWord(const string_view text) {
+    if (all_of(text.begin(), text.end(), [](char c){ return c == ' '; })) {
+        throw invalid_argument("Query word is empty"s);
+    }
+    string_view word = text;
+    bool is_minus = false;
+    if (word[0] == '-') {
+        is_minus = true;
+        word = word.substr(1);
+    }
+    if (all_of(word.begin(), word.end(), [](char c){ return c == ' '; }) || word[0] == '-' || !IsValidWord(word)) {
+        throw invalid_argument("Query word "s + (string)text + " is invalid");
+    }
+    return {word, is_minus};
 }
\ No newline at end of file
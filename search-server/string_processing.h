@@ -3,13 +3,70 @@
 #include <string>
 #include <string_view>
 #include <set>
+#include <functional>
 #include <algorithm>
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view text) ;
 
+// Splits text by spaces into words, reusing the capacity of the caller's buffer, and checks
+// them in the same pass. Returns the index of the first invalid word (see IsValidWord) or
+// words.size() if all are valid. Scans 16 bytes at a time with SSE2
+size_t SplitIntoWords(const std::string_view text, std::vector<std::string_view>& words) ;
+
+// A valid word must not contain special characters
+bool IsValidWord(const std::string_view word) ;
+
+struct QueryWord {
+    std::string_view data;
+    bool is_minus;
+};
+
+// Throws std::invalid_argument for empty and malformed words
+QueryWord ParseQueryWord(const std::string_view text) ;
+
+struct QueryWords {
+    std::vector<std::string_view> plus_words;
+    std::vector<std::string_view> minus_words;
+};
+
+// Splits the query into plus and minus words without stop words,
+// need_sort also sorts both lists and removes duplicates.
+// words holds the split text, the storage of both buffers is reused
+template <typename StopWordPredicate>
+void ParseQueryWords(const std::string_view text, bool need_sort, StopWordPredicate is_stop_word, std::vector<std::string_view>& words, QueryWords& result) {
+    result.plus_words.clear();
+    result.minus_words.clear();
+    SplitIntoWords(text, words);
+    for (const std::string_view word : words) {
+        const auto query_word = ParseQueryWord(word);
+        if (!is_stop_word(query_word.data)) {
+            if (query_word.is_minus) {
+                result.minus_words.push_back(query_word.data);
+            } else {
+                result.plus_words.push_back(query_word.data);
+            }
+        }
+    }
+    if (need_sort) {
+        std::sort(result.plus_words.begin(), result.plus_words.end());
+        result.plus_words.erase(std::unique(result.plus_words.begin(), result.plus_words.end()), result.plus_words.end());
+        std::sort(result.minus_words.begin(), result.minus_words.end());
+        result.minus_words.erase(std::unique(result.minus_words.begin(), result.minus_words.end()), result.minus_words.end());
+    }
+}
+
+template <typename StopWordPredicate>
+QueryWords ParseQueryWords(const std::string_view text, bool need_sort, StopWordPredicate is_stop_word) {
+    std::vector<std::string_view> words;
+    QueryWords result;
+    ParseQueryWords(text, need_sort, is_stop_word, words, result);
+    return result;
+}
+
+// The set is transparent, so it can be searched by std::string_view without building a string
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
     for (const std::string_view str_view : strings) {
         if (!std::all_of(str_view.begin(), str_view.end(), [](char c){ return c == ' '; })) {
             non_empty_strings.insert((std::string)str_view);
@@ -0,0 +1,41 @@
+#include "term_dictionary.h"
+
+using namespace std;
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+        : terms_(other.terms_)
+    {
+        RebuildIndex();
+    }
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+        if (this != &other) {
+            terms_ = other.terms_;
+            RebuildIndex();
+        }
+        return *this;
+    }
+
+uint32_t TermDictionary::Intern(const string_view term) {
+        const auto it = term_to_id_.find(term);
+        if (it != term_to_id_.end()) {
+            return it->second;
+        }
+        const uint32_t term_id = static_cast<uint32_t>(terms_.size());
+        terms_.emplace_back(term);
+        term_to_id_.emplace(terms_.back(), term_id);
+        return term_id;
+    }
+
+uint32_t TermDictionary::Find(const string_view term) const {
+        const auto it = term_to_id_.find(term);
+        return it == term_to_id_.end() ? NO_TERM : it->second;
+    }
+
+void TermDictionary::RebuildIndex() {
+        term_to_id_.clear();
+        term_to_id_.reserve(terms_.size());
+        for (uint32_t term_id = 0; term_id < terms_.size(); ++term_id) {
+            term_to_id_.emplace(terms_[term_id], term_id);
+        }
+    }
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// Interns terms and assigns them dense ids in order of first appearance.
+// Ids are stable for the lifetime of the dictionary, strings are never moved.
+class TermDictionary {
+public:
+    static const uint32_t NO_TERM = UINT32_MAX;
+
+    TermDictionary() = default;
+
+    TermDictionary(const TermDictionary& other);
+
+    TermDictionary(TermDictionary&& other) = default;
+
+    TermDictionary& operator=(const TermDictionary& other);
+
+    TermDictionary& operator=(TermDictionary&& other) = default;
+
+    // Returns the id of the term, adding it if it is new
+    uint32_t Intern(const std::string_view term);
+
+    // Returns NO_TERM for unknown terms
+    uint32_t Find(const std::string_view term) const;
+
+    std::string_view GetTerm(uint32_t term_id) const {
+        return terms_[term_id];
+    }
+
+    size_t Size() const {
+        return terms_.size();
+    }
+
+private:
+    // std::deque never relocates its elements, so the views used as keys stay valid
+    std::deque<std::string> terms_;
+    std::unordered_map<std::string_view, uint32_t> term_to_id_;
+
+    void RebuildIndex();
+};
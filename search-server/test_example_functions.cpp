@@ -43,9 +43,14 @@ void FindTopDocuments(const SearchServer& search_server, const string& raw_query
 void MatchDocuments(const SearchServer& search_server, const string& query) {
     try {
         cout << "Матчинг документов по запросу: "s << query << endl;
-        for (const int document_id : search_server) {
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const auto matches = search_server.MatchDocuments(query, search_server);
+        vector<string_view> words;
+        for (size_t i = 0; i < matches.document_ids.size(); ++i) {
+            words.clear();
+            for (size_t term = matches.term_offsets[i]; term < matches.term_offsets[i + 1]; ++term) {
+                words.push_back(search_server.GetTerm(matches.term_ids[term]));
+            }
+            PrintMatchDocumentResult(matches.document_ids[i], words, matches.statuses[i]);
         }
     } catch (const invalid_argument& e) {
         cout << "Ошибка матчинга документов на запрос "s << query << ": "s << e.what() << endl;
@@ -0,0 +1,121 @@
+#include "thread_pool.h"
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+using namespace std;
+
+// Which worker of which pool the current thread is, tasks it submits go to its own deque
+static thread_local const ThreadPool* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+void PinCurrentThread(size_t core) {
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core % CPU_SETSIZE, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (core % (sizeof(DWORD_PTR) * 8)));
+#else
+    (void)core;
+#endif
+}
+
+ThreadPool::ThreadPool(size_t thread_count, bool pin_threads) {
+        if (thread_count == 0) {
+            thread_count = max(1u, thread::hardware_concurrency());
+        }
+        const size_t core_count = max(1u, thread::hardware_concurrency());
+        for (size_t worker = 0; worker < thread_count; ++worker) {
+            queues_.push_back(make_unique<TaskQueue>());
+        }
+        for (size_t worker = 0; worker < thread_count; ++worker) {
+            threads_.emplace_back([this, worker, pin_threads, core_count]() {
+                if (pin_threads) {
+                    PinCurrentThread(worker % core_count);
+                }
+                RunWorker(worker);
+            });
+        }
+    }
+
+ThreadPool::~ThreadPool() {
+        {
+            lock_guard guard(sleep_mutex_);
+            is_stopping_ = true;
+        }
+        wake_up_.notify_all();
+        for (thread& worker : threads_) {
+            worker.join();
+        }
+    }
+
+void ThreadPool::Submit(function<void()> task) {
+        const size_t queue = current_pool == this ? current_worker : next_queue_.fetch_add(1) % queues_.size();
+        {
+            lock_guard guard(queues_[queue]->mutex);
+            queues_[queue]->tasks.push_back(move(task));
+        }
+        {
+            lock_guard guard(sleep_mutex_);
+            ++queued_count_;
+        }
+        wake_up_.notify_one();
+    }
+
+size_t ThreadPool::GetCurrentWorker() const {
+        return current_pool == this ? current_worker : threads_.size();
+    }
+
+ThreadPool& ThreadPool::GetDefault() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+bool ThreadPool::TryRunTask(size_t worker) {
+        function<void()> task;
+        for (size_t i = 0; i < queues_.size() && !task; ++i) {
+            TaskQueue& queue = *queues_[(worker + i) % queues_.size()];
+            lock_guard guard(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        if (!task) {
+            return false;
+        }
+        {
+            lock_guard guard(sleep_mutex_);
+            --queued_count_;
+        }
+        task();
+        return true;
+    }
+
+void ThreadPool::RunWorker(size_t worker) {
+        current_pool = this;
+        current_worker = worker;
+        while (true) {
+            if (TryRunTask(worker)) {
+                continue;
+            }
+            unique_lock lock(sleep_mutex_);
+            wake_up_.wait(lock, [this]() {
+                return is_stopping_ || queued_count_ > 0;
+            });
+            if (is_stopping_ && queued_count_ == 0) {
+                return;
+            }
+        }
+    }
@@ -0,0 +1,145 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <execution>
+#include <type_traits>
+#include <cstddef>
+
+// Fixed set of worker threads, every worker with its own task deque. A worker runs its newest
+// task first and steals the oldest task of another worker when it runs dry. Tasks pushed from
+// a worker go to its own deque, so nested parallel calls stay on the same threads instead of
+// oversubscribing the cores
+class ThreadPool {
+public:
+    // thread_count 0 means std::thread::hardware_concurrency(); with pin_threads worker i is bound
+    // to core i modulo the core count where the platform supports it
+    explicit ThreadPool(size_t thread_count = 0, bool pin_threads = false);
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Finishes the queued tasks
+    ~ThreadPool();
+
+    size_t GetThreadCount() const {
+        return threads_.size();
+    }
+
+    // Index of the calling thread among the workers, GetThreadCount() for a thread of its own
+    size_t GetCurrentWorker() const;
+
+    // Runs function(i) for every i in [0, count) and returns when all calls are done.
+    // Indexes are claimed one at a time, so a slow one holds up nobody else. The calling thread
+    // claims indexes too, which makes nested calls from tasks safe. The first exception is
+    // rethrown after all calls are done
+    template <typename Function>
+    void ParallelFor(size_t count, Function function);
+
+    void Submit(std::function<void()> task);
+
+    // Shared by everything that has no pool of its own, created on first use
+    static ThreadPool& GetDefault();
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_queue_ = 0;
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_up_;
+    size_t queued_count_ = 0;
+    bool is_stopping_ = false;
+
+    // Takes a task from the own deque of the worker or steals one
+    bool TryRunTask(size_t worker);
+
+    void RunWorker(size_t worker);
+};
+
+template <typename Function>
+    void ThreadPool::ParallelFor(size_t count, Function function) {
+        if (count <= 1 || threads_.empty()) {
+            for (size_t index = 0; index < count; ++index) {
+                function(index);
+            }
+            return;
+        }
+
+        // Helpers that start late find no index left, the state outlives them
+        struct State {
+            std::atomic<size_t> next_index = 0;
+            std::atomic<size_t> done_count = 0;
+            std::mutex mutex;
+            std::condition_variable all_done;
+            std::exception_ptr error;
+        };
+        const auto state = std::make_shared<State>();
+        const size_t total = count;
+        Function* const function_ptr = &function;
+        const auto run_indexes = [state, total, function_ptr]() {
+            size_t index;
+            while ((index = state->next_index.fetch_add(1)) < total) {
+                try {
+                    (*function_ptr)(index);
+                } catch (...) {
+                    std::lock_guard guard(state->mutex);
+                    if (!state->error) {
+                        state->error = std::current_exception();
+                    }
+                }
+                if (state->done_count.fetch_add(1) + 1 == total) {
+                    std::lock_guard guard(state->mutex);
+                    state->all_done.notify_all();
+                }
+            }
+        };
+
+        const size_t helper_count = std::min(count, threads_.size() + 1) - 1;
+        for (size_t i = 0; i < helper_count; ++i) {
+            Submit(run_indexes);
+        }
+        run_indexes();
+
+        // Every index left is running on some thread now
+        std::unique_lock lock(state->mutex);
+        state->all_done.wait(lock, [&state, total]() {
+            return state->done_count.load() == total;
+        });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+// Policies whose work runs on the pool, every parallel path branches on this one test
+template <typename ExecutionPolicy>
+constexpr bool IsParallelPolicy() {
+    using Policy = std::decay_t<ExecutionPolicy>;
+    return std::is_same_v<Policy, std::execution::parallel_policy>
+        || std::is_same_v<Policy, std::execution::parallel_unsequenced_policy>;
+}
+
+// Runs function(i) for every i in [0, count): on the pool under a parallel policy, in order otherwise
+template <typename ExecutionPolicy, typename Function>
+void ForEachIndex(ExecutionPolicy policy, ThreadPool& pool, size_t count, Function function) {
+    if constexpr (IsParallelPolicy<ExecutionPolicy>()) {
+        pool.ParallelFor(count, function);
+    } else {
+        for (size_t index = 0; index < count; ++index) {
+            function(index);
+        }
+    }
+}
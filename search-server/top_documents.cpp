@@ -0,0 +1,79 @@
+#include "top_documents.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+bool IsBetterDocument(const Document& lhs, const Document& rhs) {
+    if (abs(lhs.relevance - rhs.relevance) < numeric_limits<double>::epsilon()) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    } else {
+        return lhs.relevance > rhs.relevance;
+    }
+}
+
+TopDocumentsCollector::TopDocumentsCollector(size_t capacity)
+        : capacity_(capacity)
+    {
+        documents_.reserve(capacity);
+    }
+
+void TopDocumentsCollector::Add(const Document& document) {
+        if (has_after_ && !IsBetterDocument(after_, document)) {
+            return;
+        }
+        if (documents_.size() < capacity_) {
+            documents_.push_back(document);
+            push_heap(documents_.begin(), documents_.end(), IsBetterDocument);
+        } else if (capacity_ > 0 && IsBetterDocument(document, documents_.front())) {
+            pop_heap(documents_.begin(), documents_.end(), IsBetterDocument);
+            documents_.back() = document;
+            push_heap(documents_.begin(), documents_.end(), IsBetterDocument);
+        }
+    }
+
+bool TopDocumentsCollector::CanAdmit(double max_relevance) const {
+        // Bounds are summed in a different order than relevances, the slack absorbs the rounding
+        static const double BOUND_SLACK = 1e-9;
+        if (capacity_ == 0) {
+            return false;
+        }
+        if (!IsFull()) {
+            return true;
+        }
+        // A document within epsilon of the worst kept one may still win on rating or id
+        return max_relevance + BOUND_SLACK > documents_.front().relevance - numeric_limits<double>::epsilon();
+    }
+
+void TopDocumentsCollector::Merge(const TopDocumentsCollector& other) {
+        for (const Document& document : other.documents_) {
+            Add(document);
+        }
+    }
+
+vector<Document> TopDocumentsCollector::Extract() {
+        sort_heap(documents_.begin(), documents_.end(), IsBetterDocument);
+        vector<Document> result;
+        result.swap(documents_);
+        return result;
+    }
+
+void TopDocumentsCollector::ExtractTo(vector<Document>& result) {
+        sort_heap(documents_.begin(), documents_.end(), IsBetterDocument);
+        result.assign(documents_.begin(), documents_.end());
+        documents_.clear();
+    }
+
+void TopDocumentsCollector::Reset(size_t capacity, const Document* after) {
+        capacity_ = capacity;
+        documents_.clear();
+        documents_.reserve(capacity);
+        has_after_ = after != nullptr;
+        if (has_after_) {
+            after_ = *after;
+        }
+    }
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "document.h"
+
+// Ranking order of search results: higher relevance first, relevances closer than
+// epsilon are ordered by higher rating, then by lower id
+bool IsBetterDocument(const Document& lhs, const Document& rhs);
+
+// Bounded selection of the best documents: a heap with the worst kept document on top,
+// so every candidate costs O(log k) instead of sorting the whole match set
+class TopDocumentsCollector {
+public:
+    explicit TopDocumentsCollector(size_t capacity);
+
+    void Add(const Document& document);
+
+    void Merge(const TopDocumentsCollector& other);
+
+    bool IsFull() const {
+        return documents_.size() == capacity_;
+    }
+
+    // False when no document with relevance up to max_relevance could be added anymore
+    bool CanAdmit(double max_relevance) const;
+
+    // Heap top, requires a non-empty collector
+    const Document& Worst() const {
+        return documents_.front();
+    }
+
+    size_t Size() const {
+        return documents_.size();
+    }
+
+    // Returns the kept documents, best first
+    std::vector<Document> Extract();
+
+    // Extract into the storage of result, leaves the collector empty
+    void ExtractTo(std::vector<Document>& result);
+
+    // Empties the collector for another selection, keeps the storage.
+    // With after set only documents ranked strictly after it are admitted, e.g. for the next page
+    void Reset(size_t capacity, const Document* after = nullptr);
+
+private:
+    size_t capacity_;
+    std::vector<Document> documents_;
+    Document after_;
+    bool has_after_ = false;
+};